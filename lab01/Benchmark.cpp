@@ -0,0 +1,195 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+#include "MyQuicksort_t984h395.hpp"
+
+// Counts the branch mispredictions of the calling thread through perf_event_open
+// Valid() is false when the kernel does not allow it (e.g. perf_event_paranoid or no PMU in a VM)
+class BranchMissCounter
+{
+public:
+  BranchMissCounter() : fd_(-1)
+  {
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+  }
+  ~BranchMissCounter()
+  {
+#ifdef __linux__
+    if (fd_ >= 0)
+      close(fd_);
+#endif
+  }
+  bool Valid() const { return fd_ >= 0; }
+  void Start()
+  {
+#ifdef __linux__
+    if (fd_ >= 0)
+    {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+  long long Stop()
+  {
+    long long count = 0;
+#ifdef __linux__
+    if (fd_ >= 0)
+    {
+      ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd_, &count, sizeof(count)) != sizeof(count))
+        count = 0;
+    }
+#endif
+    return count;
+  }
+
+private:
+  int fd_;
+};
+
+// Sorts copies of data with the given engine and prints the best wall time and the branch misses per element
+template <typename Comparable>
+void Run(const std::string &name, const std::vector<Comparable> &data, int repetitions,
+         std::function<void(std::vector<Comparable> &)> engine)
+{
+  BranchMissCounter counter;
+  double best = 1e100;
+  long long misses = 0;
+  for (int r = 0; r < repetitions; ++r)
+  {
+    std::vector<Comparable> a = data;
+    auto start = std::chrono::steady_clock::now();
+    counter.Start();
+    engine(a);
+    long long m = counter.Stop();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (seconds < best)
+    {
+      best = seconds;
+      misses = m;
+    }
+    if (!IsSorted(a))
+      std::cout << name << ": result is not sorted" << std::endl;
+  }
+  std::printf("%-28s %10.2f ms", name.c_str(), best * 1000);
+  if (counter.Valid())
+    std::printf(" %10.3f branch misses/element", (double)misses / data.size());
+  else
+    std::printf(" %10s branch misses/element", "n/a");
+  std::printf("\n");
+}
+
+// Sorts random float or double arrays with NaNs among the keys in both directions and checks that the other
+// keys come out in order and that no NaN is lost; the NaNs themselves may end up anywhere
+template <typename T>
+bool CheckNaNs(std::mt19937_64 &rng)
+{
+  bool ok = true;
+  for (int n : {100, 5000, 200000})
+    for (int reverse = 0; reverse < 2; ++reverse)
+    {
+      std::vector<T> a(n);
+      for (auto &x : a)
+        x = rng() % 4 == 0 ? std::numeric_limits<T>::quiet_NaN() : (T)(rng() % 16) - 8;
+      // the median of three is a NaN when the other two keys are equal; this makes it so for the first pivot
+      a[0] = a[(n - 1) / 2] = 0;
+      a[n - 1] = std::numeric_limits<T>::quiet_NaN();
+      std::vector<T> expected;
+      for (T x : a)
+        if (x == x)
+          expected.push_back(x);
+      if (reverse)
+        std::sort(expected.begin(), expected.end(), std::greater<T>());
+      else
+        std::sort(expected.begin(), expected.end());
+      Quicksort(a, 0, n - 1, reverse == 1);
+      std::vector<T> keys;
+      for (T x : a)
+        if (x == x)
+          keys.push_back(x);
+      ok = ok && keys == expected;
+    }
+  return ok;
+}
+
+// Sorts arrays with many duplicate keys that are already in ascending or descending order again in both
+// directions, with TrySortRuns and with the drivers; each must be a single natural run
+bool CheckPresorted(std::mt19937_64 &rng)
+{
+  bool ok = true;
+  std::vector<int> sorted(100000);
+  for (auto &x : sorted)
+    x = (int)(rng() % 64);
+  std::sort(sorted.begin(), sorted.end());
+  for (int descending = 0; descending < 2; ++descending)
+    for (int reverse = 0; reverse < 2; ++reverse)
+    {
+      std::vector<int> a = sorted;
+      if (descending)
+        std::reverse(a.begin(), a.end());
+      std::vector<int> b = a, c = a;
+      ok = ok && (reverse ? TrySortRuns(a, std::greater<int>()) : TrySortRuns(a, std::less<int>()));
+      Quicksort(b, reverse == 1);
+      ParallelQuicksort(c, reverse == 1);
+      ok = ok && IsSorted(a, reverse == 1) && b == a && c == a;
+    }
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t n = argc > 1 ? std::stoul(argv[1]) : 4000000;
+  int repetitions = argc > 2 ? std::stoi(argv[2]) : 3;
+
+  std::mt19937_64 rng(630);
+  std::vector<long long> random(n), few(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    random[i] = (long long)rng();
+    few[i] = (long long)(rng() % 16);
+  }
+
+  // correctness checks of edge cases before the timings
+  bool nans = CheckNaNs<float>(rng) && CheckNaNs<double>(rng);
+  std::cout << "NaN keys: " << (nans ? "ok" : "NOT SORTED") << std::endl;
+  std::cout << "presorted duplicate keys: " << (CheckPresorted(rng) ? "ok" : "NOT A SINGLE RUN") << std::endl;
+
+  std::cout << n << " 64-bit integers, best of " << repetitions << std::endl;
+  std::cout << "random keys:" << std::endl;
+  Run<long long>("Quicksort (three-way loop)", random, repetitions, [](std::vector<long long> &a)
+                 { Quicksort(a, 0, (int)a.size() - 1); });
+  Run<long long>("BlockQuicksort", random, repetitions, [](std::vector<long long> &a)
+                 { BlockQuicksort(a); });
+  std::cout << "16 distinct keys:" << std::endl;
+  Run<long long>("Quicksort (three-way loop)", few, repetitions, [](std::vector<long long> &a)
+                 { Quicksort(a, 0, (int)a.size() - 1); });
+  Run<long long>("BlockQuicksort", few, repetitions, [](std::vector<long long> &a)
+                 { BlockQuicksort(a); });
+  return 0;
+}
@@ -0,0 +1,21 @@
+#include <iostream>
+#include <string>
+
+#include "MyExternalSort_t984h395.hpp"
+
+// Sorts a comma-separated integer file that does not need to fit into memory
+// Usage: ./ExternalSort <input> <output> [memory budget in MB] [reverse]
+int main(int argc, char *argv[])
+{
+  if (argc < 3)
+  {
+    std::cout << "Usage: " << argv[0] << " <input> <output> [memory budget in MB] [reverse]" << std::endl;
+    return 1;
+  }
+  ExternalSortOptions options;
+  if (argc > 3)
+    options.memory_budget = (size_t)std::stoul(argv[3]) << 20;
+  if (argc > 4)
+    options.reverse = std::string(argv[4]) == "reverse";
+  return ExternalSort(argv[1], argv[2], options) ? 0 : 1;
+}
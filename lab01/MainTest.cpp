@@ -1,54 +1,138 @@
 #include <iostream>
 #include <vector>
-#include <fstream>
 #include <string>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "MyQuicksort_t984h395.hpp"
 
 using namespace std;
 
-void parseInstance(const std::string &line, std::vector<std::string> &res)
+// Files below this size are parsed on the calling thread only
+const size_t PARALLEL_PARSE_MIN_SIZE = 1 << 20;
+
+// Parses the comma-terminated integers of text[begin, end) into out and returns how many were written
+// A token is the text between two commas; like std::stoi it skips leading white space, takes an optional
+// sign and reads digits up to the first non-digit. Text after the last comma of a line is ignored, and
+// tokens without digits are skipped.
+size_t ParseIntTokens(const char *text, size_t begin, size_t end, int *out)
 {
-  int p = 0, q = 0;
-  while (q < line.size())
+  size_t count = 0;
+  const char *p = text + begin, *stop = text + end;
+  while (p < stop)
   {
-    if (line[q] == ',')
-    {
-      res.push_back(line.substr(p, q - p));
-      p = q + 1;
-    }
-    q++;
+    const char *comma = (const char *)std::memchr(p, ',', stop - p);
+    if (!comma)
+      break;
+    // a token never spans lines: keep only the part after the last newline
+    for (const char *q = comma; q > p; --q)
+      if (q[-1] == '\n')
+      {
+        p = q;
+        break;
+      }
+    while (p < comma && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f'))
+      ++p;
+    bool negative = false;
+    if (p < comma && (*p == '-' || *p == '+'))
+      negative = *p++ == '-';
+    const char *digits = p;
+    unsigned long long value = 0;
+    while (p < comma && (unsigned)(*p - '0') < 10)
+      value = value * 10 + (unsigned)(*p++ - '0');
+    if (p != digits)
+      out[count++] = (int)(negative ? 0 - value : value);
+    p = comma + 1;
   }
+  return count;
 }
 
-int main(int argc, char *argv[])
+// Loads the integers of a test instance file into data
+// The file is mapped into memory and cut after commas into one chunk per thread. Every chunk is parsed
+// straight into its own slice of data (a chunk holds at most as many integers as commas), and the slices
+// are then moved together. Returns false if the file cannot be read.
+bool LoadInstance(const char *path, std::vector<int> &data)
 {
-  std::ifstream fin;
-  std::vector<std::string> data;
-  fin.open(argv[1]);  // open file
-  if (!fin.is_open()) // fail to open
+  data.clear();
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
   {
-    std::cout << "Cannot open the test instance file. Abort." << std::endl;
-    return 0;
+    close(fd);
+    return false;
+  }
+  size_t size = (size_t)info.st_size;
+  if (size == 0)
+  {
+    close(fd);
+    return true;
+  }
+  void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+  madvise(mapping, size, MADV_SEQUENTIAL);
+  const char *text = (const char *)mapping;
+
+  unsigned num_threads = size < PARALLEL_PARSE_MIN_SIZE ? 1 : std::max(1u, std::thread::hardware_concurrency());
+  std::vector<size_t> bounds(num_threads + 1, size);
+  bounds[0] = 0;
+  for (unsigned t = 1; t < num_threads; ++t)
+  {
+    size_t from = std::max(bounds[t - 1], size / num_threads * t);
+    const char *comma = (const char *)std::memchr(text + from, ',', size - from);
+    bounds[t] = comma ? comma - text + 1 : size;
   }
-  else
+
+  std::vector<size_t> commas(num_threads + 1, 0), counts(num_threads, 0);
+  RunOnThreads(num_threads, [&](unsigned t)
+               {
+                 size_t n = 0;
+                 for (const char *p = text + bounds[t], *stop = text + bounds[t + 1];
+                      (p = (const char *)std::memchr(p, ',', stop - p)) != NULL; ++p)
+                   ++n;
+                 commas[t + 1] = n; });
+  for (unsigned t = 0; t < num_threads; ++t)
+    commas[t + 1] += commas[t];
+  data.resize(commas[num_threads]);
+  RunOnThreads(num_threads, [&](unsigned t)
+               { counts[t] = ParseIntTokens(text, bounds[t], bounds[t + 1], data.data() + commas[t]); });
+  munmap(mapping, size);
+
+  size_t n = counts[0];
+  for (unsigned t = 1; t < num_threads; ++t)
   {
-    std::string line;
-    while (std::getline(fin, line))
-    {
-      parseInstance(line, data);
-    }
+    if (n != commas[t])
+      std::memmove(data.data() + n, data.data() + commas[t], counts[t] * sizeof(int));
+    n += counts[t];
   }
+  data.resize(n);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
   std::vector<int> data2;
-  for (auto x : data)
-    data2.push_back(std::stoi(x));
+  if (argc < 2 || !LoadInstance(argv[1], data2)) // fail to open
+  {
+    std::cout << "Cannot open the test instance file. Abort." << std::endl;
+    return 0;
+  }
   PrintArray(data2);
   // sort INTEGER array in ascending order
-  Quicksort(data2);
+  ParallelQuicksort(data2);
   IsSorted(data2);
   PrintArray(data2);
   // sort INTEGER array in descending order
-  Quicksort(data2, true);
+  ParallelQuicksort(data2, true);
   IsSorted(data2, true);
   PrintArray(data2);
 
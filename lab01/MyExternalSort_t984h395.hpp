@@ -0,0 +1,445 @@
+#ifndef _MY_EXTERNAL_SORT_
+#define _MY_EXTERNAL_SORT_
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <iostream>
+#include <future>
+#include <algorithm>
+#include <functional>
+#include <unistd.h>
+
+#include "MyQuicksort_t984h395.hpp"
+
+const size_t EXTERNAL_READ_CHUNK = 1 << 20;       // bytes of input text read at a time
+const size_t EXTERNAL_MIN_RUN_BUFFER = 1 << 12;   // smallest per-run merge buffer, in elements
+const size_t EXTERNAL_MAX_FANIN = 256;            // at most this many runs are merged at once
+const size_t EXTERNAL_DEFAULT_BUDGET = 64 << 20; // default memory budget in bytes
+
+// Options of ExternalSort
+// memory_budget: bytes of memory used for buffers; inputs many times larger are sorted in several runs
+// temp_dir: directory receiving the temporary run files
+// reverse: if set true, sort in descending order; otherwise ascending order
+struct ExternalSortOptions
+{
+  ExternalSortOptions() : memory_budget(EXTERNAL_DEFAULT_BUDGET), temp_dir("."), reverse(false) {}
+
+  size_t memory_budget;
+  std::string temp_dir;
+  bool reverse;
+};
+
+// Reads a binary file of T in blocks; while the caller consumes one block the next one is read in the background
+template <typename T>
+class DoubleBufferedReader
+{
+public:
+  DoubleBufferedReader(const std::string &path, size_t block)
+      : file_(std::fopen(path.c_str(), "rb")), current_(block), next_(block), size_(0), pos_(0)
+  {
+    if (file_)
+    {
+      size_ = std::fread(current_.data(), sizeof(T), current_.size(), file_);
+      Prefetch();
+    }
+  }
+  ~DoubleBufferedReader()
+  {
+    if (pending_.valid())
+      pending_.wait();
+    if (file_)
+      std::fclose(file_);
+  }
+
+  bool IsOpen() const { return file_ != NULL; }
+
+  // Returns false at the end of the file; otherwise stores the next element in x
+  bool Next(T &x)
+  {
+    if (pos_ == size_ && !Refill())
+      return false;
+    x = current_[pos_++];
+    return true;
+  }
+
+  // Returns false at the end of the file; otherwise hands out the unread rest of the current block
+  bool NextBlock(const T *&data, size_t &size)
+  {
+    if (pos_ == size_ && !Refill())
+      return false;
+    data = current_.data() + pos_;
+    size = size_ - pos_;
+    pos_ = size_;
+    return true;
+  }
+
+private:
+  // Swaps in the block read in the background and starts reading the one after it
+  bool Refill()
+  {
+    if (size_ == 0 || !pending_.valid())
+      return false;
+    size_ = pending_.get();
+    current_.swap(next_);
+    pos_ = 0;
+    if (size_ == 0)
+      return false;
+    Prefetch();
+    return true;
+  }
+
+  void Prefetch()
+  {
+    FILE *file = file_;
+    std::vector<T> *next = &next_;
+    pending_ = std::async(std::launch::async, [file, next]()
+                          { return std::fread(next->data(), sizeof(T), next->size(), file); });
+  }
+
+  FILE *file_;
+  std::vector<T> current_, next_;
+  size_t size_, pos_;
+  std::future<size_t> pending_;
+};
+
+// Writes bytes to a file in blocks; a full block is written in the background while the next one is filled
+class DoubleBufferedWriter
+{
+public:
+  DoubleBufferedWriter(const std::string &path, size_t block)
+      : file_(std::fopen(path.c_str(), "wb")), block_(block), ok_(file_ != NULL)
+  {
+    current_.reserve(block);
+    next_.reserve(block);
+  }
+  ~DoubleBufferedWriter() { Close(); }
+
+  bool IsOpen() const { return file_ != NULL; }
+
+  // Copies data into the current block, handing every full block to the background write; a block never grows
+  // beyond its reserved size, so the writer holds at most two blocks
+  void Write(const char *data, size_t size)
+  {
+    while (size > 0)
+    {
+      size_t take = std::min(size, block_ - current_.size());
+      current_.insert(current_.end(), data, data + take);
+      data += take;
+      size -= take;
+      if (current_.size() == block_)
+        Flush();
+    }
+  }
+
+  // Writes everything out; returns false if any write failed
+  bool Close()
+  {
+    if (file_)
+    {
+      Flush();
+      Wait();
+      ok_ = std::fclose(file_) == 0 && ok_;
+      file_ = NULL;
+    }
+    return ok_;
+  }
+
+private:
+  void Wait()
+  {
+    if (pending_.valid())
+      ok_ = pending_.get() && ok_;
+  }
+
+  void Flush()
+  {
+    Wait();
+    current_.swap(next_);
+    current_.clear();
+    FILE *file = file_;
+    std::vector<char> *full = &next_;
+    pending_ = std::async(std::launch::async, [file, full]()
+                          { return std::fwrite(full->data(), 1, full->size(), file) == full->size(); });
+  }
+
+  FILE *file_;
+  size_t block_;
+  bool ok_;
+  std::vector<char> current_, next_;
+  std::future<bool> pending_;
+};
+
+// Tournament tree of losers for merging k sorted sequences
+// Node 0 holds the index of the overall winner and nodes 1..k-1 the loser of the match played there, so replacing
+// the winner by the next element of its sequence takes one comparison per level.
+template <typename T, typename Less>
+class LoserTree
+{
+public:
+  // Plays the initial tournament; head[i] is the first element of sequence i, done[i] tells that it is empty
+  LoserTree(const std::vector<T> &head, const std::vector<bool> &done, Less less)
+      : k_((int)head.size()), head_(head), done_(done), tree_(head.size(), (int)head.size()), less_(less)
+  {
+    for (int s = 0; s < k_; ++s)
+      Replay(s);
+  }
+
+  // Index of the sequence holding the smallest head, or -1 once every sequence is exhausted
+  int Winner() const { return done_[tree_[0]] ? -1 : tree_[0]; }
+  const T &Head(int s) const { return head_[s]; }
+
+  // Replaces the head of the winning sequence and replays its matches up to the root
+  void Advance(const T &x)
+  {
+    head_[tree_[0]] = x;
+    Replay(tree_[0]);
+  }
+  void Exhaust()
+  {
+    done_[tree_[0]] = true;
+    Replay(tree_[0]);
+  }
+
+private:
+  // True if sequence a wins against sequence b; index k_ stands for a virtual minimum used while building
+  bool Beats(int a, int b) const
+  {
+    if (a == k_ || b == k_)
+      return a == k_;
+    if (done_[a] || done_[b])
+      return !done_[a];
+    return less_(head_[a], head_[b]) || (!less_(head_[b], head_[a]) && a < b);
+  }
+
+  void Replay(int s)
+  {
+    for (int t = (s + k_) / 2; t > 0; t /= 2)
+      if (Beats(tree_[t], s))
+        std::swap(s, tree_[t]);
+    tree_[0] = s;
+  }
+
+  int k_;
+  std::vector<T> head_;
+  std::vector<bool> done_;
+  std::vector<int> tree_;
+  Less less_;
+};
+
+// Parses comma-separated integers across chunk boundaries, with the same rules as the lab driver: a token only counts
+// once its terminating comma is seen, and a line break drops the unterminated token. Like std::stoi a token skips
+// leading white space, takes one optional sign and reads digits up to the first non-digit; the rest of the token is
+// ignored, and tokens without digits are skipped.
+class IntCsvTokenizer
+{
+public:
+  IntCsvTokenizer() : value_(0), negative_(false), digits_(false), state_(START) {}
+
+  template <typename Emit>
+  void Feed(const char *p, size_t n, Emit emit)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      char c = p[i];
+      bool digit = (unsigned)(c - '0') < 10;
+      if (c == ',')
+      {
+        if (digits_)
+          emit((int)(negative_ ? 0 - value_ : value_));
+        Reset();
+      }
+      else if (c == '\n')
+        Reset();
+      else if (state_ == START && (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'))
+        continue;
+      else if (state_ == START && (c == '-' || c == '+'))
+      {
+        negative_ = c == '-';
+        state_ = SIGNED;
+      }
+      else if (digit && state_ != SKIP)
+      {
+        value_ = value_ * 10 + (unsigned)(c - '0');
+        state_ = DIGITS;
+        digits_ = true;
+      }
+      else
+        state_ = SKIP;
+    }
+  }
+
+private:
+  enum State
+  {
+    START,  // before the sign and the digits, white space is skipped
+    SIGNED, // after the sign
+    DIGITS, // inside the digits
+    SKIP    // after the first character that ends the number
+  };
+
+  void Reset()
+  {
+    value_ = 0;
+    negative_ = false;
+    digits_ = false;
+    state_ = START;
+  }
+
+  unsigned long long value_;
+  bool negative_, digits_;
+  State state_;
+};
+
+// Appends the text of x followed by a comma to out
+inline void AppendIntCsv(int x, std::vector<char> &out)
+{
+  char digits[16];
+  int n = 0;
+  unsigned long long v = x < 0 ? -(long long)x : x;
+  do
+  {
+    digits[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  if (x < 0)
+    out.push_back('-');
+  while (n)
+    out.push_back(digits[--n]);
+  out.push_back(',');
+}
+
+// Merges the sorted binary runs into output: a binary run file, or comma-separated text if text is set
+// Every run gets two blocks of block elements, so the merge needs 2 * runs.size() * block elements of memory.
+template <typename Less>
+bool MergeRuns(const std::vector<std::string> &runs, const std::string &output, bool text, size_t block, Less less)
+{
+  std::vector<std::unique_ptr<DoubleBufferedReader<int>>> readers;
+  std::vector<int> head(runs.size());
+  std::vector<bool> done(runs.size());
+  bool ok = true;
+  for (size_t i = 0; i < runs.size(); ++i)
+  {
+    readers.emplace_back(new DoubleBufferedReader<int>(runs[i], block));
+    ok = ok && readers[i]->IsOpen();
+    done[i] = !readers[i]->Next(head[i]);
+  }
+
+  DoubleBufferedWriter writer(output, block * sizeof(int));
+  ok = ok && writer.IsOpen();
+  if (ok)
+  {
+    LoserTree<int, Less> tree(head, done, less);
+    std::vector<char> pending;
+    for (int s; (s = tree.Winner()) >= 0;)
+    {
+      int x = tree.Head(s);
+      if (text)
+        AppendIntCsv(x, pending);
+      else
+        pending.insert(pending.end(), (const char *)&x, (const char *)&x + sizeof(int));
+      if (pending.size() >= 4096)
+      {
+        writer.Write(pending.data(), pending.size());
+        pending.clear();
+      }
+      int y;
+      if (readers[s]->Next(y))
+        tree.Advance(y);
+      else
+        tree.Exhaust();
+    }
+    writer.Write(pending.data(), pending.size());
+  }
+  return writer.Close() && ok;
+}
+
+// Sorts a comma-separated integer file that may be many times larger than memory
+// input: text file in the format of the lab inputs
+// output: receives the sorted integers in the same format
+// options: memory budget, temporary directory and order
+// The input is streamed in EXTERNAL_READ_CHUNK pieces; each run that fills half of the budget is sorted with Quicksort
+// (whose radix pass needs as much again) and written to a binary run file. The runs are then merged with a loser
+// tree, as many at a time as get two blocks of EXTERNAL_MIN_RUN_BUFFER elements within the budget, but at most
+// EXTERNAL_MAX_FANIN; more runs are merged in extra passes. Reads and writes are double buffered on background threads.
+// Returns false, after printing the reason, if a file cannot be opened or written.
+inline bool ExternalSort(const std::string &input, const std::string &output,
+                         const ExternalSortOptions &options = ExternalSortOptions())
+{
+  const size_t budget = std::max(options.memory_budget, 4 * EXTERNAL_READ_CHUNK);
+  const size_t runCapacity = (budget - 2 * EXTERNAL_READ_CHUNK) / (2 * sizeof(int));
+  // every merged run and the output take two blocks of at least EXTERNAL_MIN_RUN_BUFFER elements
+  const size_t fanin = std::min(EXTERNAL_MAX_FANIN,
+                                std::max<size_t>(3, budget / (2 * EXTERNAL_MIN_RUN_BUFFER * sizeof(int))) - 1);
+  const std::string prefix = options.temp_dir + "/extsort_" + std::to_string((long long)getpid()) + "_";
+
+  std::vector<std::string> runs;
+  bool ok = true;
+  {
+    DoubleBufferedReader<char> reader(input, EXTERNAL_READ_CHUNK);
+    if (!reader.IsOpen())
+    {
+      std::cout << "Cannot open the test instance file " << input << ". Abort." << std::endl;
+      return false;
+    }
+
+    IntCsvTokenizer tokenizer;
+    std::vector<int> run;
+    run.reserve(runCapacity);
+    auto flushRun = [&]()
+    {
+      Quicksort(run, options.reverse);
+      std::string path = prefix + std::to_string((unsigned long long)runs.size()) + ".bin";
+      FILE *file = std::fopen(path.c_str(), "wb");
+      ok = ok && file && std::fwrite(run.data(), sizeof(int), run.size(), file) == run.size();
+      ok = file && std::fclose(file) == 0 && ok;
+      runs.push_back(path);
+      run.clear();
+    };
+
+    const char *chunk;
+    size_t size;
+    while (ok && reader.NextBlock(chunk, size))
+      tokenizer.Feed(chunk, size, [&](int x)
+                     {
+                       run.push_back(x);
+                       if (run.size() == runCapacity)
+                         flushRun(); });
+    if (ok && (!run.empty() || runs.empty()))
+      flushRun();
+  }
+
+  // merge groups of runs until the rest fits into one final pass
+  for (size_t generation = 0; ok && runs.size() > fanin; ++generation)
+  {
+    std::vector<std::string> merged;
+    for (size_t first = 0; ok && first < runs.size(); first += fanin)
+    {
+      std::vector<std::string> group(runs.begin() + first, runs.begin() + std::min(runs.size(), first + fanin));
+      std::string path = prefix + "g" + std::to_string((unsigned long long)generation) + "_" +
+                         std::to_string((unsigned long long)merged.size()) + ".bin";
+      size_t block = std::max(EXTERNAL_MIN_RUN_BUFFER, budget / (2 * (group.size() + 1) * sizeof(int)));
+      ok = options.reverse ? MergeRuns(group, path, false, block, std::greater<int>())
+                           : MergeRuns(group, path, false, block, std::less<int>());
+      for (size_t i = 0; i < group.size(); ++i)
+        std::remove(group[i].c_str());
+      merged.push_back(path);
+    }
+    runs.swap(merged);
+  }
+
+  if (ok)
+  {
+    size_t block = std::max(EXTERNAL_MIN_RUN_BUFFER, budget / (2 * (runs.size() + 1) * sizeof(int)));
+    ok = options.reverse ? MergeRuns(runs, output, true, block, std::greater<int>())
+                         : MergeRuns(runs, output, true, block, std::less<int>());
+  }
+  for (size_t i = 0; i < runs.size(); ++i)
+    std::remove(runs[i].c_str());
+  if (!ok)
+    std::cout << "External sort of " << input << " into " << output << " failed." << std::endl;
+  return ok;
+}
+
+#endif
@@ -7,8 +7,102 @@
 #include <ctime>
 #include <assert.h>
 #include <utility>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <limits>
+#include <type_traits>
+#include <functional>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUICKSORT_X86_SIMD
+#include <immintrin.h>
+#define QUICKSORT_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#define QUICKSORT_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
 
 const int BOUNDARY_SIZE = 10; // sort directly using insertion sort if the input size is smaller than BOUNRARY_SIZE
+const int NINTHER_SIZE = 128;  // pick the pivot as the median of three medians of three for ranges at least this large
+const int PARALLEL_TASK_CUTOFF = 1 << 14;      // ranges not larger than this are sorted serially by one worker
+const int PARALLEL_PARTITION_CUTOFF = 1 << 17; // ranges at least this large are partitioned by all threads together
+const int RADIX_BITS = 11;                     // width of one radix sort digit
+const size_t RADIX_SORT_MIN_SIZE = 256;        // arithmetic arrays smaller than this are left to the comparison engine
+const int SIMD_PARTITION_MIN_SIZE = 64;        // ranges at least this large are partitioned by the vectorized kernels
+const size_t SIMD_PARTITION_CHUNK = 4096;      // elements a vectorized kernel call partitions at a time
+const int BLOCK_PARTITION_SIZE = 64;           // number of elements classified per offset block by BlockPartition
+const size_t MAX_NATURAL_RUNS = 16;            // arrays made of at most this many sorted runs are merged, not sorted
+
+// Projection that sorts elements by themselves
+struct IdentityProjection
+{
+  template <typename T>
+  const T &operator()(const T &x) const { return x; }
+};
+
+// Element comparator applying comp to the keys extracted by proj
+template <typename Compare, typename Projection>
+struct ProjectedLess
+{
+  ProjectedLess(Compare comp, Projection proj) : comp(comp), proj(proj) {}
+
+  template <typename T>
+  bool operator()(const T &x, const T &y) const { return comp(proj(x), proj(y)); }
+
+  Compare comp;
+  Projection proj;
+};
+
+// Builds the element comparator used by the engines from a key comparator and a projection
+// The identity projection is dropped so that std::less and std::greater stay recognizable by the fast paths
+template <typename Compare, typename Projection>
+ProjectedLess<Compare, Projection> MakeElementLess(Compare comp, Projection proj)
+{
+  return ProjectedLess<Compare, Projection>(comp, proj);
+}
+
+template <typename Compare>
+Compare MakeElementLess(Compare comp, IdentityProjection)
+{
+  return comp;
+}
+
+// Tells whether Less is the natural ascending (std::less) or descending (std::greater) order of T
+template <typename T, typename Less>
+struct NaturalOrder
+{
+  static const bool value = false;
+  static const bool reverse = false;
+};
+
+template <typename T>
+struct NaturalOrder<T, std::less<T>>
+{
+  static const bool value = true;
+  static const bool reverse = false;
+};
+
+template <typename T>
+struct NaturalOrder<T, std::greater<T>>
+{
+  static const bool value = true;
+  static const bool reverse = true;
+};
+
+// Returns the first position i such that a[i + 1] sorts before a[i], or a.size() if a is sorted
+template <typename Comparable, typename Less>
+size_t FindUnsorted(const std::vector<Comparable> &a, Less less)
+{
+  for (size_t i = 0; i + 1 < a.size(); ++i)
+    if (less(a[i + 1], a[i]))
+      return i;
+  return a.size();
+}
 
 // Checks if an array is sorted
 // a: input array to be checked
@@ -16,19 +110,44 @@ const int BOUNDARY_SIZE = 10; // sort directly using insertion sort if the input
 template <typename Comparable>
 bool IsSorted(std::vector<Comparable> &a, bool reverse = false)
 {
-  if (a.size() <= 1)
+  size_t i = reverse ? FindUnsorted(a, std::greater<Comparable>()) : FindUnsorted(a, std::less<Comparable>());
+  if (i == a.size())
     return true;
-  bool sorted = true;
-  for (size_t i = 0; i < a.size() - 1; ++i)
-  {
-    if ((a[i] > a[i + 1] && !reverse) || (a[i] < a[i + 1] && reverse))
-    {
-      sorted = false;
-      std::cout << "Out of order: Positions: " << i << " : " << a[i] << "  " << a[i + 1] << std::endl;
-      break;
-    }
-  }
-  return sorted;
+  std::cout << "Out of order: Positions: " << i << " : " << a[i] << "  " << a[i + 1] << std::endl;
+  return false;
+}
+
+// Checks if an array is sorted by comp applied to the keys extracted by proj
+template <typename Comparable, typename Compare, typename Projection = IdentityProjection,
+          typename std::enable_if<!std::is_arithmetic<Compare>::value, int>::type = 0>
+bool IsSorted(std::vector<Comparable> &a, Compare comp, Projection proj = Projection())
+{
+  size_t i = FindUnsorted(a, MakeElementLess(comp, proj));
+  if (i == a.size())
+    return true;
+  std::cout << "Out of order: Positions: " << i << std::endl;
+  return false;
+}
+
+// Returns floor(log2(n)) for n >= 1
+inline int FloorLog2(size_t n)
+{
+  int log = 0;
+  while (n >>= 1)
+    ++log;
+  return log;
+}
+
+// Runs job(0) ... job(num_threads - 1) concurrently; job(0) runs on the calling thread
+template <typename Job>
+void RunOnThreads(unsigned num_threads, Job job)
+{
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < num_threads; ++t)
+    threads.push_back(std::thread(job, t));
+  job(0);
+  for (size_t t = 0; t < threads.size(); ++t)
+    threads[t].join();
 }
 
 // Prints the array
@@ -44,34 +163,37 @@ void PrintArray(std::vector<Comparable> &a)
   return;
 }
 
-// The insertion sort algorithm:
+// The insertion sort algorithm ordered by the less functor:
 // a: the input array
 // left and right: the left and end indexes of the range of the elements to be sorted, inclusive
-// reverse: if set true, sort in descending order. Default: false
-template <typename Comparable>
-void InsertionSort(std::vector<Comparable> &a, int left, int right, bool reverse = false)
+// less: element comparator, less(x, y) is true if x has to be placed before y
+template <typename Comparable, typename Less>
+void InsertionSortBy(std::vector<Comparable> &a, int left, int right, Less less)
 {
-  // CODE BEGINS
   for (int i = left + 1; i <= right; ++i)
   {
     Comparable tmp = std::move(a[i]);
     int j = i;
-    if (!reverse)
-    {
-      for (; j > left && tmp < a[j - 1]; --j)
-      {
-        a[j] = std::move(a[j - 1]);
-      }
-    }
-    else
+    for (; j > left && less(tmp, a[j - 1]); --j)
     {
-      for (; j > left && tmp > a[j - 1]; --j)
-      {
-        a[j] = std::move(a[j - 1]);
-      }
+      a[j] = std::move(a[j - 1]);
     }
     a[j] = std::move(tmp);
   }
+}
+
+// The insertion sort algorithm:
+// a: the input array
+// left and right: the left and end indexes of the range of the elements to be sorted, inclusive
+// reverse: if set true, sort in descending order. Default: false
+template <typename Comparable>
+void InsertionSort(std::vector<Comparable> &a, int left, int right, bool reverse = false)
+{
+  // CODE BEGINS
+  if (reverse)
+    InsertionSortBy(a, left, right, std::greater<Comparable>());
+  else
+    InsertionSortBy(a, left, right, std::less<Comparable>());
   // CODE ENDS
 }
 
@@ -93,6 +215,492 @@ const size_t ArrayMedian3(std::vector<Comparable> &a, const size_t x, const size
   // CODE ENDS
 }
 
+// Same as ArrayMedian3 under the order given by the less functor
+template <typename Comparable, typename Less>
+size_t ArrayMedian3By(std::vector<Comparable> &a, size_t x, size_t y, size_t z, Less less)
+{
+  if (less(a[x], a[y]) ^ less(a[x], a[z]))
+    return x;
+  else if (less(a[y], a[x]) ^ less(a[y], a[z]))
+    return y;
+  else
+    return z;
+}
+
+// Chooses the pivot index for a[left..right]: median of three for small ranges,
+// Tukey's ninther (median of three medians of three) for large ones
+template <typename Comparable, typename Less>
+size_t ChoosePivot(std::vector<Comparable> &a, int left, int right, Less less)
+{
+  int mid = left + (right - left) / 2;
+  if (right - left + 1 < NINTHER_SIZE)
+    return ArrayMedian3By(a, left, mid, right, less);
+  int step = (right - left) / 8;
+  size_t m1 = ArrayMedian3By(a, left, left + step, left + 2 * step, less);
+  size_t m2 = ArrayMedian3By(a, mid - step, mid, mid + step, less);
+  size_t m3 = ArrayMedian3By(a, right - 2 * step, right - step, right, less);
+  return ArrayMedian3By(a, m1, m2, m3, less);
+}
+
+// Bentley-McIlroy three-way partition of a[left..right], used for every element type without a vectorized kernel
+// Keys equal to the pivot are swapped to the two ends while scanning and moved to the middle at the end, so that
+// afterwards a[left..lt-1] sorts before the pivot, a[lt..gt] is equal to it, and a[gt+1..right] sorts after it
+// less: element comparator, less(x, y) is true if x has to be placed before y
+template <typename Comparable, typename Less>
+void BentleyMcIlroyPartition(std::vector<Comparable> &a, int left, int right, Less less, int &lt, int &gt)
+{
+  std::swap(a[ChoosePivot(a, left, right, less)], a[left]);
+  Comparable pivot = a[left];
+
+  int i = left, j = right + 1, p = left, q = right + 1;
+  for (;;)
+  {
+    while (less(a[++i], pivot))
+      if (i == right)
+        break;
+    while (less(pivot, a[--j]))
+      if (j == left)
+        break;
+
+    if (i == j && !less(a[i], pivot) && !less(pivot, a[i]))
+      std::swap(a[++p], a[i]);
+    if (i >= j)
+      break;
+    std::swap(a[i], a[j]);
+    // a[i] came from the right scan so it does not sort after the pivot, and a[j] the other way round
+    if (!less(a[i], pivot))
+      std::swap(a[++p], a[i]);
+    if (!less(pivot, a[j]))
+      std::swap(a[--q], a[j]);
+  }
+
+  i = j + 1;
+  for (int k = left; k <= p; ++k)
+    std::swap(a[k], a[j--]);
+  for (int k = right; k >= q; --k)
+    std::swap(a[k], a[i++]);
+  lt = j + 1;
+  gt = i - 1;
+}
+
+// Partition kernels for int, unsigned, float and double
+// Every kernel is a stable partition of data[0..n): the elements x for which (swap ? pivot > x : x > pivot) != negate
+// are moved to the front in their original order and the others follow, also in order; the front count is returned.
+// Elements of the front group are written back in place, the others are staged in scratch, which must hold n + 16.
+// All kernels give exactly the same result, so the choice between them only affects speed.
+enum SimdLevel
+{
+  SIMD_SCALAR,
+  SIMD_AVX2,
+  SIMD_AVX512
+};
+
+template <typename T>
+struct IsSimdPartitionable
+    : std::integral_constant<bool, std::is_same<T, int>::value || std::is_same<T, unsigned>::value ||
+                                       std::is_same<T, float>::value || std::is_same<T, double>::value>
+{
+};
+
+// Widest kernel supported by the CPU, detected once with CPUID
+inline SimdLevel DetectSimdLevel()
+{
+#ifdef QUICKSORT_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return SIMD_AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+    return SIMD_AVX2;
+#endif
+  return SIMD_SCALAR;
+}
+
+// The kernel used by SimdPartition; may be lowered (never raised above DetectSimdLevel()) e.g. to compare kernels
+inline SimdLevel &PartitionSimdLevel()
+{
+  static SimdLevel level = DetectSimdLevel();
+  return level;
+}
+
+template <typename T>
+size_t ScalarPartition(T *data, size_t n, T pivot, bool swap, bool negate, T *scratch)
+{
+  size_t before = 0, after = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    T x = data[i];
+    if ((swap ? pivot > x : x > pivot) != negate)
+      data[before++] = x;
+    else
+      scratch[after++] = x;
+  }
+  std::memcpy(data + before, scratch, after * sizeof(T));
+  return before;
+}
+
+#ifdef QUICKSORT_X86_SIMD
+// permutevar8x32 indexes moving the lanes set in the 8-bit mask to the front, in order, followed by the others
+inline const int (*CompressTable32())[8]
+{
+  static struct Table
+  {
+    int index[256][8];
+    Table()
+    {
+      for (int m = 0; m < 256; ++m)
+      {
+        int k = 0;
+        for (int lane = 0; lane < 8; ++lane)
+          if (m >> lane & 1)
+            index[m][k++] = lane;
+        for (int lane = 0; lane < 8; ++lane)
+          if (!(m >> lane & 1))
+            index[m][k++] = lane;
+      }
+    }
+  } table;
+  return table.index;
+}
+
+// Same as CompressTable32 for four 64-bit lanes, each given as its pair of 32-bit lanes
+inline const int (*CompressTable64())[8]
+{
+  static struct Table
+  {
+    int index[16][8];
+    Table()
+    {
+      for (int m = 0; m < 16; ++m)
+      {
+        int k = 0;
+        for (int pass = 0; pass < 2; ++pass)
+          for (int lane = 0; lane < 4; ++lane)
+            if ((m >> lane & 1) != pass)
+            {
+              index[m][k++] = 2 * lane;
+              index[m][k++] = 2 * lane + 1;
+            }
+      }
+    }
+  } table;
+  return table.index;
+}
+
+QUICKSORT_TARGET_AVX2 inline __m256i Avx2Greater(__m256i x, __m256i y, int *)
+{
+  return _mm256_cmpgt_epi32(x, y);
+}
+
+QUICKSORT_TARGET_AVX2 inline __m256i Avx2Greater(__m256i x, __m256i y, unsigned *)
+{
+  const __m256i bias = _mm256_set1_epi32(INT_MIN);
+  return _mm256_cmpgt_epi32(_mm256_xor_si256(x, bias), _mm256_xor_si256(y, bias));
+}
+
+QUICKSORT_TARGET_AVX2 inline __m256i Avx2Greater(__m256i x, __m256i y, float *)
+{
+  return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(x), _mm256_castsi256_ps(y), _CMP_GT_OQ));
+}
+
+// AVX2 kernel for 32-bit elements: compares eight elements at once and compresses each side with a lane permutation
+template <typename T>
+QUICKSORT_TARGET_AVX2 size_t Avx2Partition(T *data, size_t n, T pivot, bool swap, bool negate, T *scratch)
+{
+  int pivotBits;
+  std::memcpy(&pivotBits, &pivot, sizeof(T));
+  const __m256i p = _mm256_set1_epi32(pivotBits);
+  const int flip = negate ? 0xFF : 0;
+  const int(*table)[8] = CompressTable32();
+
+  size_t i = 0, before = 0, after = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(data + i));
+    __m256i gt = swap ? Avx2Greater(p, x, (T *)0) : Avx2Greater(x, p, (T *)0);
+    int m = _mm256_movemask_ps(_mm256_castsi256_ps(gt)) ^ flip;
+    _mm256_storeu_si256((__m256i *)(data + before),
+                        _mm256_permutevar8x32_epi32(x, _mm256_loadu_si256((const __m256i *)table[m])));
+    _mm256_storeu_si256((__m256i *)(scratch + after),
+                        _mm256_permutevar8x32_epi32(x, _mm256_loadu_si256((const __m256i *)table[~m & 0xFF])));
+    int k = _mm_popcnt_u32(m);
+    before += k;
+    after += 8 - k;
+  }
+  for (; i < n; ++i)
+  {
+    T x = data[i];
+    if ((swap ? pivot > x : x > pivot) != negate)
+      data[before++] = x;
+    else
+      scratch[after++] = x;
+  }
+  std::memcpy(data + before, scratch, after * sizeof(T));
+  return before;
+}
+
+// AVX2 kernel for doubles, four elements at a time
+QUICKSORT_TARGET_AVX2 inline size_t Avx2Partition(double *data, size_t n, double pivot, bool swap, bool negate,
+                                                  double *scratch)
+{
+  const __m256d p = _mm256_set1_pd(pivot);
+  const int flip = negate ? 0xF : 0;
+  const int(*table)[8] = CompressTable64();
+
+  size_t i = 0, before = 0, after = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m256d x = _mm256_loadu_pd(data + i);
+    __m256d gt = swap ? _mm256_cmp_pd(p, x, _CMP_GT_OQ) : _mm256_cmp_pd(x, p, _CMP_GT_OQ);
+    int m = _mm256_movemask_pd(gt) ^ flip;
+    __m256i bits = _mm256_castpd_si256(x);
+    _mm256_storeu_si256((__m256i *)(data + before),
+                        _mm256_permutevar8x32_epi32(bits, _mm256_loadu_si256((const __m256i *)table[m])));
+    _mm256_storeu_si256((__m256i *)(scratch + after),
+                        _mm256_permutevar8x32_epi32(bits, _mm256_loadu_si256((const __m256i *)table[~m & 0xF])));
+    int k = _mm_popcnt_u32(m);
+    before += k;
+    after += 4 - k;
+  }
+  for (; i < n; ++i)
+  {
+    double x = data[i];
+    if ((swap ? pivot > x : x > pivot) != negate)
+      data[before++] = x;
+    else
+      scratch[after++] = x;
+  }
+  std::memcpy(data + before, scratch, after * sizeof(double));
+  return before;
+}
+
+QUICKSORT_TARGET_AVX512 inline __mmask16 Avx512Greater(__m512i x, __m512i y, int *)
+{
+  return _mm512_cmpgt_epi32_mask(x, y);
+}
+
+QUICKSORT_TARGET_AVX512 inline __mmask16 Avx512Greater(__m512i x, __m512i y, unsigned *)
+{
+  return _mm512_cmpgt_epu32_mask(x, y);
+}
+
+QUICKSORT_TARGET_AVX512 inline __mmask16 Avx512Greater(__m512i x, __m512i y, float *)
+{
+  return _mm512_cmp_ps_mask(_mm512_castsi512_ps(x), _mm512_castsi512_ps(y), _CMP_GT_OQ);
+}
+
+// AVX-512 kernel for 32-bit elements: sixteen elements at a time, each side written with a masked compress-store
+template <typename T>
+QUICKSORT_TARGET_AVX512 size_t Avx512Partition(T *data, size_t n, T pivot, bool swap, bool negate, T *scratch)
+{
+  int pivotBits;
+  std::memcpy(&pivotBits, &pivot, sizeof(T));
+  const __m512i p = _mm512_set1_epi32(pivotBits);
+  const __mmask16 flip = negate ? 0xFFFF : 0;
+
+  size_t i = 0, before = 0, after = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    __m512i x = _mm512_loadu_si512((const void *)(data + i));
+    __mmask16 m = (swap ? Avx512Greater(p, x, (T *)0) : Avx512Greater(x, p, (T *)0)) ^ flip;
+    _mm512_mask_compressstoreu_epi32((void *)(data + before), m, x);
+    _mm512_mask_compressstoreu_epi32((void *)(scratch + after), (__mmask16)~m, x);
+    int k = _mm_popcnt_u32(m);
+    before += k;
+    after += 16 - k;
+  }
+  for (; i < n; ++i)
+  {
+    T x = data[i];
+    if ((swap ? pivot > x : x > pivot) != negate)
+      data[before++] = x;
+    else
+      scratch[after++] = x;
+  }
+  std::memcpy(data + before, scratch, after * sizeof(T));
+  return before;
+}
+
+// AVX-512 kernel for doubles, eight elements at a time
+QUICKSORT_TARGET_AVX512 inline size_t Avx512Partition(double *data, size_t n, double pivot, bool swap, bool negate,
+                                                      double *scratch)
+{
+  const __m512d p = _mm512_set1_pd(pivot);
+  const __mmask8 flip = negate ? 0xFF : 0;
+
+  size_t i = 0, before = 0, after = 0;
+  for (; i + 8 <= n; i += 8)
+  {
+    __m512d x = _mm512_loadu_pd(data + i);
+    __mmask8 m = (swap ? _mm512_cmp_pd_mask(p, x, _CMP_GT_OQ) : _mm512_cmp_pd_mask(x, p, _CMP_GT_OQ)) ^ flip;
+    _mm512_mask_compressstoreu_pd(data + before, m, x);
+    _mm512_mask_compressstoreu_pd(scratch + after, (__mmask8)~m, x);
+    int k = _mm_popcnt_u32(m);
+    before += k;
+    after += 8 - k;
+  }
+  for (; i < n; ++i)
+  {
+    double x = data[i];
+    if ((swap ? pivot > x : x > pivot) != negate)
+      data[before++] = x;
+    else
+      scratch[after++] = x;
+  }
+  std::memcpy(data + before, scratch, after * sizeof(double));
+  return before;
+}
+#endif
+
+// Runs the partition kernel selected by PartitionSimdLevel()
+template <typename T>
+size_t SimdPartition(T *data, size_t n, T pivot, bool swap, bool negate, T *scratch)
+{
+#ifdef QUICKSORT_X86_SIMD
+  switch (PartitionSimdLevel())
+  {
+  case SIMD_AVX512:
+    return Avx512Partition(data, n, pivot, swap, negate, scratch);
+  case SIMD_AVX2:
+    return Avx2Partition(data, n, pivot, swap, negate, scratch);
+  default:
+    break;
+  }
+#endif
+  return ScalarPartition(data, n, pivot, swap, negate, scratch);
+}
+
+// Runs SimdPartition over data[0..n) one SIMD_PARTITION_CHUNK at a time, so that scratch needs only
+// SIMD_PARTITION_CHUNK + 16 elements. After each chunk, the elements of the chunk that go first are swapped
+// with the first elements of the second side gathered so far.
+template <typename T>
+size_t ChunkedSimdPartition(T *data, size_t n, T pivot, bool swap, bool negate, T *scratch)
+{
+  size_t before = 0;
+  for (size_t i = 0; i < n; i += SIMD_PARTITION_CHUNK)
+  {
+    size_t k = SimdPartition(data + i, std::min(SIMD_PARTITION_CHUNK, n - i), pivot, swap, negate, scratch);
+    // data[before..i) is the second side so far and data[i..i+k) the chunk's first side
+    size_t m = std::min(i - before, k);
+    std::swap_ranges(data + before, data + before + m, data + i + k - m);
+    before += k;
+  }
+  return before;
+}
+
+// Three-way partition of a[left..right] with two kernel passes: elements sorting before the pivot are moved to the
+// front, then the elements equal to it are moved to the front of the rest
+template <typename T, typename Less>
+void SimdThreeWayPartition(std::vector<T> &a, int left, int right, Less less, int &lt, int &gt)
+{
+  const bool reverse = NaturalOrder<T, Less>::reverse;
+  const T pivot = a[ChoosePivot(a, left, right, less)];
+  // A NaN pivot compares false with everything, so both passes, and the Bentley-McIlroy loop too, would take the
+  // whole range as equal to it. The NaNs are moved to the back as the pivot's group instead, and the rest is left
+  // to sort; NaNs never reach the other side of a partition, so the non-NaN elements still come out in order.
+  if (pivot != pivot)
+  {
+    int k = left;
+    for (int i = left; i <= right; ++i)
+      if (a[i] == a[i])
+        std::swap(a[k++], a[i]);
+    lt = k;
+    gt = right;
+    return;
+  }
+  static thread_local std::vector<T> scratch(SIMD_PARTITION_CHUNK + 16);
+  const size_t n = right - left + 1;
+  size_t before = ChunkedSimdPartition(&a[left], n, pivot, !reverse, false, scratch.data());
+  size_t equal = ChunkedSimdPartition(&a[left + before], n - before, pivot, reverse, true, scratch.data());
+  lt = left + (int)before;
+  gt = lt + (int)equal - 1;
+}
+
+template <typename Comparable, typename Less>
+void ThreeWayPartition(std::vector<Comparable> &a, int left, int right, Less less, int &lt, int &gt,
+                       std::false_type)
+{
+  BentleyMcIlroyPartition(a, left, right, less, lt, gt);
+}
+
+template <typename Comparable, typename Less>
+void ThreeWayPartition(std::vector<Comparable> &a, int left, int right, Less less, int &lt, int &gt,
+                       std::true_type)
+{
+  if (right - left + 1 >= SIMD_PARTITION_MIN_SIZE)
+    SimdThreeWayPartition(a, left, right, less, lt, gt);
+  else
+    BentleyMcIlroyPartition(a, left, right, less, lt, gt);
+}
+
+// Three-way partition of a[left..right] used by the quick sort engines
+// Afterwards a[left..lt-1] sorts before the pivot, a[lt..gt] is equal to it, and a[gt+1..right] sorts after it.
+// int, unsigned, float and double ranges of SIMD_PARTITION_MIN_SIZE or more, ordered by std::less or std::greater,
+// go through the vectorized kernels.
+template <typename Comparable, typename Less>
+void ThreeWayPartition(std::vector<Comparable> &a, int left, int right, Less less, int &lt, int &gt)
+{
+  ThreeWayPartition(a, left, right, less, lt, gt,
+                    std::integral_constant<bool, IsSimdPartitionable<Comparable>::value &&
+                                                     NaturalOrder<Comparable, Less>::value>());
+}
+
+// The heap sort algorithm ordered by the less functor, used when quick sort recurses too deep
+// a: the input array
+// left and right: the left and end indexes of the range of the elements to be sorted, inclusive
+// less: element comparator, less(x, y) is true if x has to be placed before y
+template <typename Comparable, typename Less>
+void HeapSortBy(std::vector<Comparable> &a, int left, int right, Less less)
+{
+  auto first = a.begin() + left, last = a.begin() + right + 1;
+  std::make_heap(first, last, less);
+  std::sort_heap(first, last, less);
+}
+
+// The heap sort algorithm
+// a: the input array
+// left and right: the left and end indexes of the range of the elements to be sorted, inclusive
+// reverse: if set true, sort in descending order. Default: false
+template <typename Comparable>
+void HeapSort(std::vector<Comparable> &a, int left, int right, bool reverse = false)
+{
+  if (reverse)
+    HeapSortBy(a, left, right, std::greater<Comparable>());
+  else
+    HeapSortBy(a, left, right, std::less<Comparable>());
+}
+
+// The introsort loop: three-way quick sort that switches to heap sort once depth_limit partitions were spent
+// a: the array to be sorted
+// left and right: the indexes for the range to be sorted, inclusive
+// depth_limit: number of partition levels allowed before falling back to heap sort
+// less: element comparator, less(x, y) is true if x has to be placed before y
+template <typename Comparable, typename Less>
+void IntroQuicksort(std::vector<Comparable> &a, int left, int right, int depth_limit, Less less)
+{
+  while (left + BOUNDARY_SIZE <= right)
+  {
+    if (depth_limit-- == 0)
+    {
+      HeapSortBy(a, left, right, less);
+      return;
+    }
+    int lt, gt;
+    ThreeWayPartition(a, left, right, less, lt, gt);
+    // recurse into the smaller side and loop on the larger one to keep the stack O(log n)
+    if (lt - left < right - gt)
+    {
+      IntroQuicksort(a, left, lt - 1, depth_limit, less);
+      left = gt + 1;
+    }
+    else
+    {
+      IntroQuicksort(a, gt + 1, right, depth_limit, less);
+      right = lt - 1;
+    }
+  }
+  InsertionSortBy(a, left, right, less);
+}
+
 // The recursive quick sort function
 // a: the array to be sorted
 // left and right: the indexes for the range to be sorted, inclusive
@@ -101,56 +709,863 @@ template <typename Comparable>
 void Quicksort(std::vector<Comparable> &a, int left, int right, bool reverse = false)
 {
   // CODE BEGINS
-  if (left + BOUNDARY_SIZE <= right)
+  if (left >= right)
+    return;
+  int depth_limit = 2 * FloorLog2(right - left + 1);
+  if (reverse)
+    IntroQuicksort(a, left, right, depth_limit, std::greater<Comparable>());
+  else
+    IntroQuicksort(a, left, right, depth_limit, std::less<Comparable>());
+  // CODE ENDS
+}
+
+// Block partition of a[left..right] around ChoosePivot, after Edelkamp and Weiss' BlockQuicksort
+// Instead of branching on every comparison, each side scans a block of BLOCK_PARTITION_SIZE elements and
+// unconditionally writes the offset of every element, advancing the offset count by the comparison result.
+// The misplaced elements recorded on both sides are then swapped in bulk.
+// Returns the final index of the pivot: a[left..pivot-1] sorts before it and a[pivot+1..right] does not.
+template <typename Comparable, typename Less>
+int BlockPartition(std::vector<Comparable> &a, int left, int right, Less less)
+{
+  std::swap(a[ChoosePivot(a, left, right, less)], a[left]);
+  Comparable pivot = std::move(a[left]);
+
+  // skip the prefix and the suffix already on their sides
+  int first = left + 1, last = right;
+  while (first <= right && less(a[first], pivot))
+    ++first;
+  while (last >= first && !less(a[last], pivot))
+    --last;
+
+  if (first < last)
   {
-    size_t pivotIndex = ArrayMedian3(a, left, (left + right) / 2, right);
-    std::swap(a[pivotIndex], a[right]);
-    Comparable pivot = a[right];
+    std::swap(a[first], a[last]);
+    ++first; // the unknown elements are a[first..last-1] from now on
+
+    alignas(64) unsigned char offsetsLeft[BLOCK_PARTITION_SIZE];
+    alignas(64) unsigned char offsetsRight[BLOCK_PARTITION_SIZE];
+    int baseLeft = first, baseRight = last;
+    int numLeft = 0, numRight = 0, startLeft = 0, startRight = 0;
 
-    int i = left - 1, j = right;
-    for (;;)
+    while (first < last)
     {
-      if (!reverse)
+      // refill whichever offset block ran empty; split the unknown elements when both did
+      int unknown = last - first;
+      int leftSplit = numLeft == 0 ? (numRight == 0 ? unknown / 2 : unknown) : 0;
+      int rightSplit = numRight == 0 ? unknown - leftSplit : 0;
+      if (leftSplit > BLOCK_PARTITION_SIZE)
+        leftSplit = BLOCK_PARTITION_SIZE;
+      if (rightSplit > BLOCK_PARTITION_SIZE)
+        rightSplit = BLOCK_PARTITION_SIZE;
+
+      for (int i = 0; i < leftSplit; ++i)
       {
-        while (a[++i] < pivot)
-        {
-        }
-        while (pivot < a[--j])
-          if (j == left)
-            break;
+        offsetsLeft[numLeft] = (unsigned char)i;
+        numLeft += !less(a[first++], pivot);
       }
-      else
+      for (int i = 1; i <= rightSplit; ++i)
       {
-        while (a[++i] > pivot)
-        {
-        }
-        while (pivot > a[--j])
-          if (j == left)
-            break;
+        offsetsRight[numRight] = (unsigned char)i;
+        numRight += less(a[--last], pivot);
       }
 
-      if (i >= j)
-        break;
-      std::swap(a[i], a[j]);
+      int num = std::min(numLeft, numRight);
+      for (int k = 0; k < num; ++k)
+        std::swap(a[baseLeft + offsetsLeft[startLeft + k]], a[baseRight - offsetsRight[startRight + k]]);
+      numLeft -= num;
+      numRight -= num;
+      startLeft += num;
+      startRight += num;
+      if (numLeft == 0)
+      {
+        startLeft = 0;
+        baseLeft = first;
+      }
+      if (numRight == 0)
+      {
+        startRight = 0;
+        baseRight = last;
+      }
+    }
+
+    // the leftovers of one block still sit on the wrong side; swap them next to the boundary
+    while (numLeft > 0)
+    {
+      --numLeft;
+      std::swap(a[baseLeft + offsetsLeft[startLeft + numLeft]], a[--last]);
+      first = last;
     }
+    while (numRight > 0)
+    {
+      --numRight;
+      std::swap(a[baseRight - offsetsRight[startRight + numRight]], a[first++]);
+      last = first;
+    }
+  }
 
-    std::swap(a[i], a[right]);
+  int pivotIndex = first - 1;
+  a[left] = std::move(a[pivotIndex]);
+  a[pivotIndex] = std::move(pivot);
+  return pivotIndex;
+}
 
-    Quicksort(a, left, i - 1, reverse);
-    Quicksort(a, i + 1, right, reverse);
+// The introsort loop of BlockQuicksort
+// begin: the left end of the whole range being sorted; an element just before left is never greater than
+// a[left..right], so a pivot equal to it means that the range starts with a run of keys equal to the pivot, which
+// are then moved to the front and skipped instead of being partitioned again
+template <typename Comparable, typename Less>
+void BlockIntroQuicksort(std::vector<Comparable> &a, int begin, int left, int right, int depth_limit, Less less)
+{
+  while (left + BOUNDARY_SIZE <= right)
+  {
+    if (depth_limit-- == 0)
+    {
+      HeapSortBy(a, left, right, less);
+      return;
+    }
+    if (left > begin)
+    {
+      const Comparable &previous = a[left - 1];
+      int pivotIndex = (int)ChoosePivot(a, left, right, less);
+      if (!less(previous, a[pivotIndex]))
+      {
+        left = std::partition(a.begin() + left, a.begin() + right + 1, [&](const Comparable &x)
+                              { return !less(previous, x); }) -
+               a.begin();
+        continue;
+      }
+    }
+    int mid = BlockPartition(a, left, right, less);
+    if (mid - left < right - mid)
+    {
+      BlockIntroQuicksort(a, begin, left, mid - 1, depth_limit, less);
+      left = mid + 1;
+    }
+    else
+    {
+      BlockIntroQuicksort(a, begin, mid + 1, right, depth_limit, less);
+      right = mid - 1;
+    }
   }
+  InsertionSortBy(a, left, right, less);
+}
+
+// The branchless block quick sort function, an alternative engine to Quicksort
+// a: the array to be sorted
+// left and right: the indexes for the range to be sorted, inclusive
+// reverse: if set true, sort in descending order; otherwise in ascending order
+// The order is fixed once here, so the partition loops test neither the order nor, mostly, the comparison results.
+template <typename Comparable>
+void BlockQuicksort(std::vector<Comparable> &a, int left, int right, bool reverse = false)
+{
+  if (left >= right)
+    return;
+  int depth_limit = 2 * FloorLog2(right - left + 1);
+  if (reverse)
+    BlockIntroQuicksort(a, left, left, right, depth_limit, std::greater<Comparable>());
   else
+    BlockIntroQuicksort(a, left, left, right, depth_limit, std::less<Comparable>());
+}
+
+// The driver block quick sort function
+template <typename Comparable>
+void BlockQuicksort(std::vector<Comparable> &a, bool reverse = false)
+{
+  BlockQuicksort(a, 0, (int)a.size() - 1, reverse);
+}
+
+// Unsigned integer type of the given size in bytes
+template <size_t Bytes>
+struct UnsignedOfSize;
+template <>
+struct UnsignedOfSize<1>
+{
+  typedef unsigned char type;
+};
+template <>
+struct UnsignedOfSize<2>
+{
+  typedef unsigned short type;
+};
+template <>
+struct UnsignedOfSize<4>
+{
+  typedef unsigned int type;
+};
+template <>
+struct UnsignedOfSize<8>
+{
+  typedef unsigned long long type;
+};
+
+// Element types sorted by RadixSort: integers (except bool) and IEEE single and double precision floats
+template <typename T>
+struct IsRadixSortable
+    : std::integral_constant<bool, (std::is_integral<T>::value && !std::is_same<T, bool>::value) ||
+                                       (std::is_floating_point<T>::value && std::numeric_limits<T>::is_iec559 &&
+                                        (sizeof(T) == 4 || sizeof(T) == 8))>
+{
+};
+
+// Maps an element to an unsigned key whose unsigned order is the ascending order of the elements
+// Signed integers get their sign bit flipped; floats get all bits flipped when negative and the sign bit otherwise
+template <typename T>
+struct RadixKey
+{
+  typedef typename UnsignedOfSize<sizeof(T)>::type type;
+  static const type SIGN_BIT = (type)((type)1 << (sizeof(T) * CHAR_BIT - 1));
+
+  static type Encode(T x) { return Encode(x, std::is_floating_point<T>()); }
+
+private:
+  static type Encode(T x, std::false_type)
   {
-    InsertionSort(a, left, right, reverse);
+    return std::is_signed<T>::value ? (type)((type)x ^ SIGN_BIT) : (type)x;
   }
-  // CODE ENDS
+  static type Encode(T x, std::true_type)
+  {
+    type bits;
+    std::memcpy(&bits, &x, sizeof(T));
+    return (bits & SIGN_BIT) ? (type)~bits : (type)(bits | SIGN_BIT);
+  }
+};
+
+// The LSD radix sort algorithm for arithmetic element types
+// a: the array to be sorted
+// reverse: if set true, sort in descending order; otherwise in ascending order
+// num_threads: each pass is histogrammed and scattered by this many threads, each one owning a contiguous chunk
+// Passes whose digit is the same for every element are skipped.
+template <typename T>
+void RadixSort(std::vector<T> &a, bool reverse = false, unsigned num_threads = 1)
+{
+  typedef typename RadixKey<T>::type Key;
+  const size_t n = a.size();
+  const size_t buckets = (size_t)1 << RADIX_BITS;
+  const int passes = (int)((sizeof(Key) * CHAR_BIT + RADIX_BITS - 1) / RADIX_BITS);
+  const Key flip = reverse ? (Key)~(Key)0 : (Key)0; // descending order is ascending order of the complemented keys
+
+  if (num_threads == 0 || n < num_threads)
+    num_threads = 1;
+  std::vector<size_t> bounds(num_threads + 1);
+  for (unsigned t = 0; t <= num_threads; ++t)
+    bounds[t] = n * t / num_threads;
+  std::vector<std::vector<size_t>> offsets(num_threads, std::vector<size_t>(buckets));
+  std::vector<T> buffer(n);
+
+  for (int pass = 0; pass < passes; ++pass)
+  {
+    const int shift = pass * RADIX_BITS;
+    RunOnThreads(num_threads, [&](unsigned t)
+                 {
+                   std::vector<size_t> &count = offsets[t];
+                   std::fill(count.begin(), count.end(), 0);
+                   for (size_t i = bounds[t]; i < bounds[t + 1]; ++i)
+                     ++count[((Key)(RadixKey<T>::Encode(a[i]) ^ flip) >> shift) & (buckets - 1)]; });
+
+    // bucket d of thread t starts after all smaller digits and after bucket d of the threads before t
+    bool trivial = false;
+    for (size_t d = 0, sum = 0; d < buckets; ++d)
+    {
+      size_t start = sum;
+      for (unsigned t = 0; t < num_threads; ++t)
+      {
+        size_t count = offsets[t][d];
+        offsets[t][d] = sum;
+        sum += count;
+      }
+      if (sum - start == n)
+        trivial = true;
+    }
+    if (trivial)
+      continue;
+
+    RunOnThreads(num_threads, [&](unsigned t)
+                 {
+                   std::vector<size_t> &next = offsets[t];
+                   for (size_t i = bounds[t]; i < bounds[t + 1]; ++i)
+                     buffer[next[((Key)(RadixKey<T>::Encode(a[i]) ^ flip) >> shift) & (buckets - 1)]++] = a[i]; });
+    a.swap(buffer);
+  }
+}
+
+template <typename Comparable, typename Less>
+bool TryRadixSort(std::vector<Comparable> &a, Less, unsigned num_threads, std::true_type)
+{
+  if (a.size() < RADIX_SORT_MIN_SIZE)
+    return false;
+  RadixSort(a, NaturalOrder<Comparable, Less>::reverse, num_threads);
+  return true;
+}
+
+template <typename Comparable, typename Less>
+bool TryRadixSort(std::vector<Comparable> &a, Less, unsigned num_threads, std::false_type)
+{
+  return false;
+}
+
+// Sorts a with RadixSort and returns true if its element type allows it and less is std::less or std::greater;
+// otherwise leaves it alone and returns false
+template <typename Comparable, typename Less>
+bool TryRadixSort(std::vector<Comparable> &a, Less less, unsigned num_threads)
+{
+  return TryRadixSort(a, less, num_threads,
+                      std::integral_constant<bool, IsRadixSortable<Comparable>::value &&
+                                                       NaturalOrder<Comparable, Less>::value>());
+}
+
+// Adaptive front end of the drivers: sorts a in O(n log r) if it consists of r <= MAX_NATURAL_RUNS natural runs
+// A run is a maximal non-decreasing or non-increasing stretch; descending runs are reversed in place and the runs
+// are then merged pairwise. The scan stops as soon as more runs are found, so arrays that are not nearly sorted only
+// pay for a prefix scan. Returns true if a was sorted here.
+// Reversing a descending run also reverses its equal keys, which the unstable drivers do not mind; Argsort's entry
+// order breaks every tie by index, so no two of its entries are equal.
+template <typename Comparable, typename Less>
+bool TrySortRuns(std::vector<Comparable> &a, Less less)
+{
+  const size_t n = a.size();
+  std::vector<size_t> bounds(1, 0);
+  bool descending[MAX_NATURAL_RUNS];
+  size_t i = 0;
+  while (i < n)
+  {
+    if (bounds.size() > MAX_NATURAL_RUNS)
+      return false;
+    // keys equal to the first one belong to the run either way; the first different key sets its direction
+    size_t j = i + 1;
+    while (j < n && !less(a[j], a[i]) && !less(a[i], a[j]))
+      ++j;
+    bool down = j < n && less(a[j], a[i]);
+    if (down)
+      while (j < n && !less(a[j - 1], a[j]))
+        ++j;
+    else
+      while (j < n && !less(a[j], a[j - 1]))
+        ++j;
+    descending[bounds.size() - 1] = down;
+    i = j;
+    bounds.push_back(i);
+  }
+
+  for (size_t r = 0; r + 1 < bounds.size(); ++r)
+    if (descending[r])
+      std::reverse(a.begin() + bounds[r], a.begin() + bounds[r + 1]);
+  while (bounds.size() > 2)
+  {
+    std::vector<size_t> next;
+    for (size_t r = 0; r + 2 < bounds.size(); r += 2)
+    {
+      std::inplace_merge(a.begin() + bounds[r], a.begin() + bounds[r + 1], a.begin() + bounds[r + 2], less);
+      next.push_back(bounds[r]);
+    }
+    if (bounds.size() % 2 == 0) // odd number of runs: the last one waits for the next round
+      next.push_back(bounds[bounds.size() - 2]);
+    next.push_back(n);
+    bounds.swap(next);
+  }
+  return true;
+}
+
+// The driver quicksort function with a compile-time comparator and key projection
+// a: the array to be sorted
+// comp: strict weak ordering of the keys, e.g. std::greater<Key>() for descending order
+// proj: maps an element to the key it is sorted by, e.g. a member accessor; defaults to the element itself
+// Both are template parameters and get inlined into the engine, so custom orders cost no run-time dispatch.
+// Arrays made of a few sorted or reverse-sorted runs are finished by TrySortRuns in linear time for one run.
+// Otherwise large arrays of integers and floats ordered by std::less or std::greater are sorted by RadixSort.
+template <typename Comparable, typename Compare, typename Projection = IdentityProjection,
+          typename std::enable_if<!std::is_arithmetic<Compare>::value, int>::type = 0>
+void Quicksort(std::vector<Comparable> &a, Compare comp, Projection proj = Projection())
+{
+  auto less = MakeElementLess(comp, proj);
+  if (a.size() > 1 && !TrySortRuns(a, less) && !TryRadixSort(a, less, 1))
+    IntroQuicksort(a, 0, (int)a.size() - 1, 2 * FloorLog2(a.size()), less);
 }
 
 // The driver quicksort function
+// reverse: if set true, sort in descending order (std::greater); otherwise in ascending order (std::less)
 template <typename Comparable>
 void Quicksort(std::vector<Comparable> &a, bool reverse = false)
 {
-  Quicksort(a, 0, a.size() - 1, reverse);
+  if (reverse)
+    Quicksort(a, std::greater<Comparable>());
+  else
+    Quicksort(a, std::less<Comparable>());
+}
+
+// The introselect loop: moves the element of rank k (0-based, within the whole array) of a[left..right] to index k
+// Only the side holding k is partitioned further. Once depth_limit partitions were spent, a heap selection
+// finishes the range, so the worst case stays O(n log n) while the expected time is O(n).
+// Afterwards no element of a[left..k-1] sorts after a[k] and no element of a[k+1..right] sorts before it.
+template <typename Comparable, typename Less>
+void IntroSelect(std::vector<Comparable> &a, int left, int right, int k, int depth_limit, Less less)
+{
+  while (left + BOUNDARY_SIZE <= right)
+  {
+    if (depth_limit-- == 0)
+    {
+      std::partial_sort(a.begin() + left, a.begin() + k + 1, a.begin() + right + 1, less);
+      return;
+    }
+    int lt, gt;
+    ThreeWayPartition(a, left, right, less, lt, gt);
+    if (k < lt)
+      right = lt - 1;
+    else if (k > gt)
+      left = gt + 1;
+    else
+      return;
+  }
+  InsertionSortBy(a, left, right, less);
+}
+
+// The quickselect function with a compile-time comparator and key projection
+// a: the array, reordered so that a[k] is the element a sorted copy would hold at index k, with no element
+//    sorting after it in front of it and none sorting before it behind it
+// k: the 0-based rank, less than a.size()
+// returns a[k]
+template <typename Comparable, typename Compare, typename Projection = IdentityProjection,
+          typename std::enable_if<!std::is_arithmetic<Compare>::value, int>::type = 0>
+Comparable QuickSelect(std::vector<Comparable> &a, size_t k, Compare comp, Projection proj = Projection())
+{
+  assert(k < a.size());
+  IntroSelect(a, 0, (int)a.size() - 1, (int)k, 2 * FloorLog2(a.size()), MakeElementLess(comp, proj));
+  return a[k];
+}
+
+// The quickselect function
+// reverse: if set true, k counts from the largest element; otherwise from the smallest
+template <typename Comparable>
+Comparable QuickSelect(std::vector<Comparable> &a, size_t k, bool reverse = false)
+{
+  if (reverse)
+    return QuickSelect(a, k, std::greater<Comparable>());
+  else
+    return QuickSelect(a, k, std::less<Comparable>());
+}
+
+// The partial quicksort function with a compile-time comparator and key projection
+// Sorts the first k positions of a: they receive the k elements that sort first, in order, and the rest of the
+// array holds the remaining elements in no particular order. Runs in O(n + k log k) expected time.
+template <typename Comparable, typename Compare, typename Projection = IdentityProjection,
+          typename std::enable_if<!std::is_arithmetic<Compare>::value, int>::type = 0>
+void PartialQuicksort(std::vector<Comparable> &a, size_t k, Compare comp, Projection proj = Projection())
+{
+  if (k >= a.size())
+  {
+    Quicksort(a, comp, proj);
+    return;
+  }
+  if (k == 0)
+    return;
+  auto less = MakeElementLess(comp, proj);
+  IntroSelect(a, 0, (int)a.size() - 1, (int)k - 1, 2 * FloorLog2(a.size()), less);
+  IntroQuicksort(a, 0, (int)k - 2, 2 * FloorLog2(k), less);
+}
+
+// The partial quicksort function
+// reverse: if set true, the first k positions get the k largest elements in descending order; otherwise the k
+//          smallest in ascending order
+template <typename Comparable>
+void PartialQuicksort(std::vector<Comparable> &a, size_t k, bool reverse = false)
+{
+  if (reverse)
+    PartialQuicksort(a, k, std::greater<Comparable>());
+  else
+    PartialQuicksort(a, k, std::less<Comparable>());
+}
+
+// The top-k function with a compile-time comparator and key projection
+// returns the min(k, a.size()) elements of a that sort first, in order; a itself is left unchanged
+template <typename Comparable, typename Compare, typename Projection = IdentityProjection,
+          typename std::enable_if<!std::is_arithmetic<Compare>::value, int>::type = 0>
+std::vector<Comparable> TopK(const std::vector<Comparable> &a, size_t k, Compare comp, Projection proj = Projection())
+{
+  std::vector<Comparable> top(a);
+  PartialQuicksort(top, k, comp, proj);
+  top.resize(std::min(k, top.size()));
+  return top;
+}
+
+// The top-k function
+// returns the k largest elements of a in descending order, or the k smallest in ascending order if smallest is set
+template <typename Comparable>
+std::vector<Comparable> TopK(const std::vector<Comparable> &a, size_t k, bool smallest = false)
+{
+  if (smallest)
+    return TopK(a, k, std::less<Comparable>());
+  else
+    return TopK(a, k, std::greater<Comparable>());
+}
+
+// 64-bit key prefix of an element for Argsort: prefix(x) < prefix(y) implies x < y, and equal prefixes say nothing
+// unless exact is set, in which case equal prefixes mean equal keys. Types without a prefix map everything to 0.
+template <typename T, bool = IsRadixSortable<T>::value>
+struct ArgsortPrefix
+{
+  static const bool exact = false;
+  static uint64_t Get(const T &) { return 0; }
+};
+
+// Integers and floats: the radix key, which orders them completely (-0.0 before 0.0, as in RadixSort)
+template <typename T>
+struct ArgsortPrefix<T, true>
+{
+  static const bool exact = true;
+  static uint64_t Get(const T &x) { return (uint64_t)RadixKey<T>::Encode(x); }
+};
+
+// Strings: the first eight characters as unsigned bytes, most significant first, padded with zeros
+template <>
+struct ArgsortPrefix<std::string, false>
+{
+  static const bool exact = false;
+  static uint64_t Get(const std::string &x)
+  {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; ++i)
+      prefix = (prefix << 8) | (i < x.size() ? (unsigned char)x[i] : 0);
+    return prefix;
+  }
+};
+
+// The compact element sorted by Argsort in place of the element itself
+struct ArgsortEntry
+{
+  uint64_t prefix;
+  uint32_t index;
+};
+
+// Orders Argsort entries by prefix, then by the element comparator on the referenced elements, then by index
+// The index tie-break makes the order total, so equal elements keep their original order.
+template <typename Comparable, typename Less, bool Exact>
+struct ArgsortEntryLess
+{
+  const std::vector<Comparable> *a;
+  Less less;
+
+  bool operator()(const ArgsortEntry &x, const ArgsortEntry &y) const
+  {
+    if (x.prefix != y.prefix)
+      return x.prefix < y.prefix;
+    if (!Exact)
+    {
+      if (less((*a)[x.index], (*a)[y.index]))
+        return true;
+      if (less((*a)[y.index], (*a)[x.index]))
+        return false;
+    }
+    return x.index < y.index;
+  }
+};
+
+// Sorts the entries of a, whose prefixes are already filled in, and returns the permutation they give
+template <bool Exact, typename Comparable, typename Less>
+std::vector<uint32_t> ArgsortEntries(const std::vector<Comparable> &a, std::vector<ArgsortEntry> &entries, Less less)
+{
+  ArgsortEntryLess<Comparable, Less, Exact> entryLess = {&a, less};
+  if (entries.size() > 1 && !TrySortRuns(entries, entryLess))
+    IntroQuicksort(entries, 0, (int)entries.size() - 1, 2 * FloorLog2(entries.size()), entryLess);
+  std::vector<uint32_t> perm(entries.size());
+  for (size_t i = 0; i < entries.size(); ++i)
+    perm[i] = entries[i].index;
+  return perm;
+}
+
+// The indirect sort function with a compile-time comparator and key projection
+// a: the array to be ordered; it is not modified
+// comp, proj: the key order and the key projection, as for Quicksort(a, comp, proj)
+// returns perm such that a[perm[0]], a[perm[1]], ... is a in sorted order; equal keys keep their original order
+// Only (prefix, index) entries are moved while sorting; with a custom order the prefix is unused and every
+// comparison looks at the elements.
+template <typename Comparable, typename Compare, typename Projection = IdentityProjection,
+          typename std::enable_if<!std::is_arithmetic<Compare>::value, int>::type = 0>
+std::vector<uint32_t> Argsort(const std::vector<Comparable> &a, Compare comp, Projection proj = Projection())
+{
+  assert(a.size() <= (size_t)UINT32_MAX);
+  std::vector<ArgsortEntry> entries(a.size());
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    entries[i].prefix = 0;
+    entries[i].index = (uint32_t)i;
+  }
+  return ArgsortEntries<false>(a, entries, MakeElementLess(comp, proj));
+}
+
+// The indirect sort function
+// a: the array to be ordered; it is not modified
+// reverse: if set true, the permutation lists a in descending order; otherwise in ascending order
+// returns perm such that a[perm[0]], a[perm[1]], ... is a in sorted order; equal elements keep their original order
+// Integers and floats are ordered by their radix key alone and strings mostly by their first eight characters, so
+// the elements themselves are only read when two prefixes tie.
+template <typename Comparable>
+std::vector<uint32_t> Argsort(const std::vector<Comparable> &a, bool reverse = false)
+{
+  typedef ArgsortPrefix<Comparable> Prefix;
+  assert(a.size() <= (size_t)UINT32_MAX);
+  std::vector<ArgsortEntry> entries(a.size());
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    uint64_t prefix = Prefix::Get(a[i]);
+    entries[i].prefix = reverse ? ~prefix : prefix;
+    entries[i].index = (uint32_t)i;
+  }
+  if (reverse)
+    return ArgsortEntries<Prefix::exact>(a, entries, std::greater<Comparable>());
+  else
+    return ArgsortEntries<Prefix::exact>(a, entries, std::less<Comparable>());
+}
+
+// Reorders a in place so that the new a[i] is the old a[perm[i]], e.g. with a permutation returned by Argsort
+// Every cycle of the permutation is rotated through a single temporary element. The positions already placed are
+// marked in the top bit of their perm entries, which a last pass clears, so perm is unchanged on return and no
+// memory beyond the temporary is used. a may hold at most 2^31 elements.
+template <typename Comparable>
+void ApplyPermutation(std::vector<Comparable> &a, std::vector<uint32_t> &perm)
+{
+  const uint32_t placed = 0x80000000u;
+  assert(perm.size() == a.size() && a.size() <= (size_t)placed);
+  for (size_t start = 0; start < a.size(); ++start)
+  {
+    if ((perm[start] & placed) || perm[start] == start)
+      continue;
+    Comparable temp = std::move(a[start]);
+    size_t i = start;
+    for (size_t next; (next = perm[i]) != start; i = next)
+    {
+      perm[i] |= placed;
+      a[i] = std::move(a[next]);
+    }
+    perm[i] |= placed;
+    a[i] = std::move(temp);
+  }
+  for (size_t i = 0; i < perm.size(); ++i)
+    perm[i] &= ~placed;
+}
+
+// Same as above for a permutation that is not needed afterwards, e.g. ApplyPermutation(a, Argsort(a))
+template <typename Comparable>
+void ApplyPermutation(std::vector<Comparable> &a, std::vector<uint32_t> &&perm)
+{
+  ApplyPermutation(a, perm);
+}
+
+// Partitions a[left..right] around ChoosePivot using num_threads threads and returns the final index of the pivot
+// Each thread partitions its own chunk, then the chunks are scattered through a buffer so that all elements ordered
+// before the pivot precede all the others. Requires Comparable to be default constructible.
+template <typename Comparable, typename Less>
+int ParallelPartition(std::vector<Comparable> &a, int left, int right, Less less, unsigned num_threads)
+{
+  size_t pivotIndex = ChoosePivot(a, left, right, less);
+  std::swap(a[pivotIndex], a[right]);
+  const Comparable pivot = a[right];
+
+  const int n = right - left; // number of elements excluding the pivot
+  std::vector<int> bounds(num_threads + 1), before(num_threads), beforeOffset(num_threads), afterOffset(num_threads);
+  for (unsigned t = 0; t <= num_threads; ++t)
+    bounds[t] = left + (int)((long long)n * t / num_threads);
+
+  RunOnThreads(num_threads, [&](unsigned t)
+               { before[t] = std::partition(a.begin() + bounds[t], a.begin() + bounds[t + 1],
+                                            [&](const Comparable &x)
+                                            { return less(x, pivot); }) -
+                             (a.begin() + bounds[t]); });
+
+  int totalBefore = 0;
+  for (unsigned t = 0; t < num_threads; ++t)
+    totalBefore += before[t];
+  for (unsigned t = 0, b = 0, f = totalBefore; t < num_threads; ++t)
+  {
+    beforeOffset[t] = b;
+    afterOffset[t] = f;
+    b += before[t];
+    f += bounds[t + 1] - bounds[t] - before[t];
+  }
+
+  std::vector<Comparable> buffer(n);
+  RunOnThreads(num_threads, [&](unsigned t)
+               {
+                 int split = bounds[t] + before[t];
+                 std::move(a.begin() + bounds[t], a.begin() + split, buffer.begin() + beforeOffset[t]);
+                 std::move(a.begin() + split, a.begin() + bounds[t + 1], buffer.begin() + afterOffset[t]); });
+  RunOnThreads(num_threads, [&](unsigned t)
+               { std::move(buffer.begin() + (bounds[t] - left), buffer.begin() + (bounds[t + 1] - left), a.begin() + bounds[t]); });
+
+  int mid = left + totalBefore;
+  std::swap(a[mid], a[right]);
+  return mid;
+}
+
+// A range of the array still to be sorted, along with its remaining partition depth budget
+struct QuicksortTask
+{
+  int left, right, depth_limit;
+};
+
+// Work-stealing pool of quicksort tasks used by ParallelQuicksort
+// Each worker owns a deque of ranges: it pushes and pops at the back of its own deque and,
+// when that runs dry, steals from the front of the other workers' deques
+template <typename Comparable, typename Less>
+class QuicksortTaskPool
+{
+public:
+  QuicksortTaskPool(std::vector<Comparable> &a, Less less, unsigned num_threads)
+      : a_(a), less_(less), queues_(num_threads), locks_(num_threads), pending_(0) {}
+
+  // Queues the range a[left..right] on the deque of the given worker
+  void Push(unsigned worker, int left, int right, int depth_limit)
+  {
+    QuicksortTask task = {left, right, depth_limit};
+    pending_.fetch_add(1);
+    std::lock_guard<std::mutex> guard(locks_[worker]);
+    queues_[worker].push_back(task);
+  }
+
+  // Runs the workers until every queued range is sorted; worker 0 is the calling thread
+  void Run()
+  {
+    RunOnThreads((unsigned)queues_.size(), [this](unsigned worker)
+                 { WorkerLoop(worker); });
+  }
+
+private:
+  bool Pop(unsigned worker, QuicksortTask &task)
+  {
+    {
+      std::lock_guard<std::mutex> guard(locks_[worker]);
+      if (!queues_[worker].empty())
+      {
+        task = queues_[worker].back();
+        queues_[worker].pop_back();
+        return true;
+      }
+    }
+    for (size_t k = 1; k < queues_.size(); ++k)
+    {
+      size_t victim = (worker + k) % queues_.size();
+      std::lock_guard<std::mutex> guard(locks_[victim]);
+      if (!queues_[victim].empty())
+      {
+        task = queues_[victim].front();
+        queues_[victim].pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void WorkerLoop(unsigned worker)
+  {
+    QuicksortTask task;
+    while (pending_.load() > 0)
+    {
+      if (Pop(worker, task))
+      {
+        Process(worker, task.left, task.right, task.depth_limit);
+        pending_.fetch_sub(1);
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // Splits large ranges, forking the larger side as a new task, and sorts the rest serially
+  void Process(unsigned worker, int left, int right, int depth_limit)
+  {
+    while (right - left + 1 > PARALLEL_TASK_CUTOFF && depth_limit > 0)
+    {
+      int lt, gt;
+      ThreeWayPartition(a_, left, right, less_, lt, gt);
+      --depth_limit;
+      if (lt - left > right - gt)
+      {
+        Push(worker, left, lt - 1, depth_limit);
+        left = gt + 1;
+      }
+      else
+      {
+        Push(worker, gt + 1, right, depth_limit);
+        right = lt - 1;
+      }
+    }
+    if (left < right)
+      IntroQuicksort(a_, left, right, depth_limit, less_);
+  }
+
+  std::vector<Comparable> &a_;
+  Less less_;
+  std::vector<std::deque<QuicksortTask>> queues_;
+  std::vector<std::mutex> locks_;
+  std::atomic<long> pending_;
+};
+
+// The parallel driver quicksort function with a compile-time comparator and key projection
+// a: the array to be sorted
+// comp, proj: the key order and the key projection, as for Quicksort(a, comp, proj)
+// num_threads: number of worker threads, defaults to the number of hardware threads
+// Nearly sorted arrays are finished by TrySortRuns, and arithmetic arrays ordered by std::less or std::greater go to
+// the multi-threaded RadixSort. Otherwise the top levels
+// are partitioned by all threads together and the resulting ranges are then sorted by a work-stealing pool.
+// The sort is not stable, and the partitions differ from the serial Quicksort: elements whose keys compare equal
+// (e.g. records that share a projected key) may end up in a different order than Quicksort(a, comp, proj) puts them.
+// Only when the comparison looks at the whole element, so that equal keys mean equal elements, are the outputs identical.
+template <typename Comparable, typename Compare, typename Projection = IdentityProjection,
+          typename std::enable_if<!std::is_arithmetic<Compare>::value, int>::type = 0>
+void ParallelQuicksort(std::vector<Comparable> &a, Compare comp, Projection proj = Projection(),
+                       unsigned num_threads = std::thread::hardware_concurrency())
+{
+  auto less = MakeElementLess(comp, proj);
+  if (num_threads == 0) // hardware_concurrency() may be unable to tell
+    num_threads = 1;
+  if (TrySortRuns(a, less) || TryRadixSort(a, less, num_threads))
+    return;
+  if (num_threads == 1 || a.size() <= (size_t)PARALLEL_TASK_CUTOFF)
+  {
+    Quicksort(a, comp, proj);
+    return;
+  }
+
+  std::vector<std::pair<int, int>> ranges(1, std::make_pair(0, (int)a.size() - 1));
+  for (unsigned width = 1; width < num_threads; width *= 2)
+  {
+    std::vector<std::pair<int, int>> next;
+    for (size_t k = 0; k < ranges.size(); ++k)
+    {
+      int left = ranges[k].first, right = ranges[k].second;
+      if (right - left + 1 >= PARALLEL_PARTITION_CUTOFF)
+      {
+        int mid = ParallelPartition(a, left, right, less, num_threads);
+        next.push_back(std::make_pair(left, mid - 1));
+        next.push_back(std::make_pair(mid + 1, right));
+      }
+      else
+      {
+        next.push_back(ranges[k]);
+      }
+    }
+    ranges.swap(next);
+  }
+
+  int depth_limit = 2 * FloorLog2(a.size());
+  QuicksortTaskPool<Comparable, decltype(less)> pool(a, less, num_threads);
+  for (size_t k = 0; k < ranges.size(); ++k)
+    pool.Push((unsigned)(k % num_threads), ranges[k].first, ranges[k].second, depth_limit);
+  pool.Run();
+}
+
+// The parallel driver quicksort function
+// a: the array to be sorted
+// reverse: if set true, sort in descending order (std::greater); otherwise in ascending order (std::less)
+// num_threads: number of worker threads, defaults to the number of hardware threads
+template <typename Comparable>
+void ParallelQuicksort(std::vector<Comparable> &a, bool reverse = false,
+                       unsigned num_threads = std::thread::hardware_concurrency())
+{
+  if (reverse)
+    ParallelQuicksort(a, std::greater<Comparable>(), IdentityProjection(), num_threads);
+  else
+    ParallelQuicksort(a, std::less<Comparable>(), IdentityProjection(), num_threads);
 }
 
 #endif
\ No newline at end of file
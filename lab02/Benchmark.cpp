@@ -0,0 +1,413 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "MyAlt_t984h395.h"
+#include "MyContraction_t984h395.h"
+#include "MyDeltaStepping_t984h395.h"
+#include "MyDynamicSssp_t984h395.h"
+#include "MyFloydWarshall_t984h395.h"
+#include "MyPathMatrix_t984h395.h"
+#include "MyQueryServer_t984h395.h"
+
+const unsigned ALT_BENCH_LANDMARKS = 16; // landmarks built for the ALT queries
+const int DYNAMIC_BENCH_BATCHES = 100;    // update batches applied to the dynamic tree
+const int DYNAMIC_BENCH_BATCH_SIZE = 10;  // edge updates per batch
+
+// Wraps a priority queue of BuildShortestPathTree and counts what goes through it
+template <typename Queue>
+class CountingQueue
+{
+public:
+    static size_t pushes, pops, peak;
+
+    void Reset(NodeType n) { queue_.Reset(n); }
+    void Push(NodeType v, WeightType dist)
+    {
+        pushes++;
+        queue_.Push(v, dist);
+        peak = std::max(peak, queue_.Size());
+    }
+    bool Pop(NodeType &u, WeightType &dist)
+    {
+        if (!queue_.Pop(u, dist))
+            return false;
+        pops++;
+        return true;
+    }
+    size_t Size() const { return queue_.Size(); }
+
+private:
+    Queue queue_;
+};
+
+template <typename Queue>
+size_t CountingQueue<Queue>::pushes = 0;
+template <typename Queue>
+size_t CountingQueue<Queue>::pops = 0;
+template <typename Queue>
+size_t CountingQueue<Queue>::peak = 0;
+
+// Builds the trees of the given sources with Queue, checks them against the reference
+// trees and prints the best time of the repetitions with the queue statistics
+// entry_bytes: size of one heap entry; the indexed heap also keeps 8 bytes per node besides its entries
+template <typename Queue>
+void Run(const char *name, size_t entry_bytes, const CsrGraph &graph, const std::vector<NodeType> &sources,
+         const std::vector<ShortestPathTree> &reference, int repetitions)
+{
+    typedef CountingQueue<Queue> Counted;
+    double best = 1e100;
+    bool same = true;
+    ShortestPathTree tree;
+    for (int r = 0; r < repetitions; r++)
+    {
+        Counted::pushes = Counted::pops = Counted::peak = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < sources.size(); k++)
+        {
+            BuildShortestPathTree<Counted>(graph, sources[k], tree);
+            same = same && tree.distances == reference[k].distances && tree.previous == reference[k].previous;
+        }
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::printf("%-22s %9.2f ms %12zu pushes %12zu pops %10zu peak entries %10.1f peak heap KB%s\n", name, best * 1000,
+                Counted::pushes, Counted::pops, Counted::peak, Counted::peak * entry_bytes / 1024.0,
+                same ? "" : "  TREES DIFFER");
+}
+
+// Builds the trees of the sources with delta-stepping and prints the best total time
+// of the repetitions; the trees are checked against the reference trees of Dijkstra
+void RunDeltaStepping(const CsrGraph &graph, WeightType delta, unsigned num_threads,
+                      const std::vector<NodeType> &sources, const std::vector<ShortestPathTree> &reference,
+                      int repetitions)
+{
+    DeltaStepping engine(graph, delta, num_threads);
+    ShortestPathTree tree;
+    bool same = true;
+    double best = 1e100;
+    for (int r = 0; r < repetitions; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < sources.size(); k++)
+        {
+            engine.BuildShortestPathTree(sources[k], tree);
+            same = same && tree.distances == reference[k].distances && tree.previous == reference[k].previous;
+        }
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::printf("delta %-8u %2u threads %9.2f ms%s\n", engine.Delta(), engine.Threads(), best * 1000,
+                same ? "" : "  TREES DIFFER");
+}
+
+// Checks delta-stepping, the dynamic tree and the all-pairs driver against Dijkstra on dense random graphs with
+// weights 0..3 and 0..1, where nodes at the same distance are joined by zero-weight edges and cycles
+void RunZeroWeights(unsigned num_threads)
+{
+    std::mt19937 rng(630);
+    bool same = true;
+    for (WeightType max_weight : {3u, 1u})
+    {
+        EdgeListType edges;
+        const NodeType n = max_weight == 3 ? 300 : 200;
+        for (NodeType u = 0; u < n; u++)
+            for (int k = 0; k < (max_weight == 3 ? 100 : 60); k++)
+                edges.push_back({u, (NodeType)(rng() % n), (WeightType)(rng() % (max_weight + 1))});
+        CsrGraph graph;
+        BuildCsrGraph(edges, graph);
+        DeltaStepping engine(graph, 0, num_threads);
+        ShortestPathTree reference, tree;
+        for (NodeType source = 0; source < n; source += 37)
+        {
+            BuildShortestPathTree(graph, source, reference);
+            engine.BuildShortestPathTree(source, tree);
+            same = same && tree.distances == reference.distances && tree.previous == reference.previous;
+        }
+        DynamicShortestPathTree dynamic(graph, 0);
+        std::vector<EdgeUpdate> batch;
+        for (int b = 0; b < 20; b++)
+        {
+            batch.clear();
+            for (int k = 0; k < 10; k++)
+                batch.push_back({(NodeType)(rng() % n), (NodeType)(rng() % n),
+                                 rng() % 4 == 0 ? DYNAMIC_EDGE_REMOVED : (WeightType)(rng() % (max_weight + 1))});
+            dynamic.Apply(batch);
+            BuildShortestPathTree(dynamic.Graph(), 0, reference);
+            same = same && dynamic.Tree().distances == reference.distances &&
+                   dynamic.Tree().previous == reference.previous;
+        }
+        std::ostringstream all_pairs, all_pairs_auto;
+        AllPairsShortestPaths(graph, num_threads, AppendPathMatrixRow, all_pairs);
+        AllPairsShortestPaths_Auto(graph, num_threads, AppendPathMatrixRow, all_pairs_auto);
+        same = same && all_pairs.str() == all_pairs_auto.str();
+    }
+    std::cout << "zero weights: " << (same ? "ok" : "TREES DIFFER") << std::endl;
+}
+
+// Builds the trees of all sources with one Dijkstra run each, then with the blocked Floyd-Warshall engine,
+// checks that both give the same trees and prints the best time of each
+void RunAllPairs(const CsrGraph &graph, int repetitions)
+{
+    const NodeType n = graph.size();
+    std::vector<ShortestPathTree> reference(n);
+    ShortestPathTree tree;
+    DistanceMatrix matrix;
+    double dijkstra = 1e100, floyd = 1e100;
+    bool same = true;
+    for (int r = 0; r < repetitions; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (NodeType source = 0; source < n; source++)
+            BuildShortestPathTree(graph, source, reference[source]);
+        dijkstra = std::min(dijkstra, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        start = std::chrono::steady_clock::now();
+        FloydWarshall(graph, matrix, 1);
+        for (NodeType source = 0; source < n; source++)
+        {
+            BuildMatrixTree(graph, matrix, source, tree);
+            same = same && tree.distances == reference[source].distances && tree.previous == reference[source].previous;
+        }
+        floyd = std::min(floyd, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::printf("all pairs: %9.2f ms Dijkstra, %9.2f ms Floyd-Warshall (%s)%s\n", dijkstra * 1000, floyd * 1000,
+                PreferFloydWarshall(n, graph.targets.size(),
+                                    std::find(graph.weights.begin(), graph.weights.end(), 0) != graph.weights.end())
+                    ? "chosen"
+                    : "not chosen",
+                same ? "" : "  TREES DIFFER");
+}
+
+// Applies random batches of edge insertions, deletions and weight changes to a dynamic tree of source and
+// checks it after every batch against a tree rebuilt from scratch; prints the time of both
+void RunDynamicUpdates(const CsrGraph &graph, NodeType source)
+{
+    DynamicShortestPathTree dynamic(graph, source);
+    std::mt19937 rng(630);
+    std::vector<EdgeUpdate> batch;
+    ShortestPathTree tree;
+    double update_seconds = 0, rebuild_seconds = 0;
+    size_t repaired = 0;
+    bool same = true;
+    for (int b = 0; b < DYNAMIC_BENCH_BATCHES; b++)
+    {
+        batch.clear();
+        for (int k = 0; k < DYNAMIC_BENCH_BATCH_SIZE; k++)
+        {
+            NodeType u = (NodeType)(rng() % graph.size());
+            const auto &edges = dynamic.Graph()[u];
+            // a third of the updates delete an edge, the others re-weight or insert one
+            if (!edges.empty() && rng() % 3 == 0)
+                batch.push_back({u, edges[rng() % edges.size()].first, DYNAMIC_EDGE_REMOVED});
+            else if (!edges.empty() && rng() % 2 == 0)
+                batch.push_back({u, edges[rng() % edges.size()].first, (WeightType)(rng() % 1000 + 1)});
+            else
+                batch.push_back({u, (NodeType)(rng() % graph.size()), (WeightType)(rng() % 1000 + 1)});
+        }
+        auto start = std::chrono::steady_clock::now();
+        repaired += dynamic.Apply(batch);
+        auto middle = std::chrono::steady_clock::now();
+        BuildShortestPathTree(dynamic.Graph(), source, tree);
+        auto end = std::chrono::steady_clock::now();
+        update_seconds += std::chrono::duration<double>(middle - start).count();
+        rebuild_seconds += std::chrono::duration<double>(end - middle).count();
+        same = same && tree.distances == dynamic.Tree().distances && tree.previous == dynamic.Tree().previous;
+    }
+    std::printf("%d batches of %d updates: repaired %9.2f ms, %.1f nodes/batch; rebuilt %9.2f ms%s\n",
+                DYNAMIC_BENCH_BATCHES, DYNAMIC_BENCH_BATCH_SIZE, update_seconds * 1000,
+                (double)repaired / DYNAMIC_BENCH_BATCHES, rebuild_seconds * 1000, same ? "" : "  TREES DIFFER");
+}
+
+// Answers the source-target queries with one of the point-to-point modes and prints the
+// total time and the average number of entries taken out of the queues per query
+// mode: 0 builds the whole tree, 1 stops at the target, 2 is the bidirectional search, 3 is ALT,
+// 4 is the contraction hierarchy answered by ch_query, 5 stops at the target in a reused DijkstraWorkspace
+void RunQueries(const char *name, int mode, const CsrGraph &graph, const CsrGraph &reverse, const LandmarkTable &table,
+                ContractionHierarchyQuery *ch_query,
+                const std::vector<std::pair<NodeType, NodeType>> &queries, const std::vector<WeightType> &lengths)
+{
+    typedef CountingQueue<BinaryHeapQueue> Counted;
+    Counted::pushes = Counted::pops = Counted::peak = 0;
+    bool same = true;
+    ShortestPathTree tree;
+    DijkstraWorkspace<Counted> workspace;
+    std::vector<NodeType> path;
+    size_t settled = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < queries.size(); k++)
+    {
+        WeightType length;
+        size_t count;
+        if (mode == 3)
+        {
+            // ALT keeps its own queue, so count the nodes it settles instead
+            ShortestPath_ALT(graph, table, queries[k].first, queries[k].second, length, path, &count);
+            settled += count;
+        }
+        else if (mode == 4)
+        {
+            ch_query->ShortestPath(queries[k].first, queries[k].second, length, path, &count);
+            settled += count;
+        }
+        else if (mode == 5)
+            workspace.ShortestPath(graph, queries[k].first, queries[k].second, length, path);
+        else if (mode == 2)
+            ShortestPath_BidirectionalDijkstra<Counted>(graph, reverse, queries[k].first, queries[k].second, length, path);
+        else
+        {
+            BuildShortestPathTree<Counted>(graph, queries[k].first, tree, mode == 1 ? queries[k].second : UINT_MAX);
+            ExtractPath(tree, queries[k].second, length, path);
+        }
+        same = same && length == lengths[k];
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-22s %9.2f ms %12.1f %s/query%s\n", name, seconds * 1000,
+                (double)(mode == 3 || mode == 4 ? settled : Counted::pops) / queries.size(),
+                mode == 3 || mode == 4 ? "settled" : "pops",
+                same ? "" : "  LENGTHS DIFFER");
+}
+
+// Sends the queries as request lines to a query server that caches the trees of half the sources, in a shuffled
+// order so that trees are evicted and built again; checks the replied lengths and prints the server's stats
+void RunQueryServer(const CsrGraph &graph, size_t num_sources, const std::vector<std::pair<NodeType, NodeType>> &queries,
+                    const std::vector<WeightType> &lengths)
+{
+    QueryServer<CsrGraph> server(graph, std::max<size_t>(1, num_sources / 2));
+    std::vector<size_t> order(queries.size());
+    for (size_t k = 0; k < order.size(); k++)
+        order[k] = k;
+    std::shuffle(order.begin(), order.end(), std::mt19937(630));
+    bool same = true;
+    std::string request, reply;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t k : order)
+    {
+        request = std::to_string(queries[k].first) + " " + std::to_string(queries[k].second);
+        reply.clear();
+        server.Handle(request.data(), request.data() + request.size(), reply);
+        same = same && reply.size() > 1 && std::stoul(reply.substr(reply.rfind(' ', reply.size() - 2) + 1)) == lengths[k];
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    reply.clear();
+    server.AppendStats(reply);
+    std::printf("%-22s %9.2f ms %s%s", "query server", seconds * 1000, same ? "" : "LENGTHS DIFFER ", reply.c_str());
+}
+
+int main(int argc, char *argv[])
+{
+    // usage: ./Bench [input file | random node count] [sources] [repetitions] [landmark file] [contraction threads]
+    std::string input = argc > 1 ? argv[1] : "100000";
+    size_t num_sources = argc > 2 ? std::stoul(argv[2]) : 20;
+    int repetitions = argc > 3 ? std::stoi(argv[3]) : 3;
+
+    CsrGraph graph;
+    EdgeListType edges;
+    if (input.find_first_not_of("0123456789") == std::string::npos)
+    {
+        // random graph with 8 out-edges per node and weights 1..1000
+        NodeType n = (NodeType)std::stoul(input);
+        std::mt19937 rng(630);
+        for (NodeType u = 0; u < n; u++)
+            for (int k = 0; k < 8; k++)
+                edges.push_back({u, (NodeType)(rng() % n), (WeightType)(rng() % 1000 + 1)});
+    }
+    else
+    {
+        std::ifstream fin(input);
+        if (!fin.is_open())
+        {
+            std::cout << "Cannot open the test instance file " << input << ". Abort." << std::endl;
+            return 0;
+        }
+        NodeType u, v;
+        WeightType w;
+        while (fin >> u >> v >> w)
+            edges.push_back({u, v, w});
+    }
+    BuildCsrGraph(edges, graph);
+    if (graph.size() == 0)
+        return 0;
+
+    std::vector<NodeType> sources;
+    for (size_t k = 0; k < num_sources; k++)
+        sources.push_back((NodeType)(k * graph.size() / num_sources));
+    std::vector<ShortestPathTree> reference(sources.size());
+    for (size_t k = 0; k < sources.size(); k++)
+        BuildShortestPathTree(graph, sources[k], reference[k]);
+
+    std::cout << graph.size() << " nodes, " << graph.targets.size() << " edges, " << sources.size()
+              << " sources, best of " << repetitions << std::endl;
+    Run<BinaryHeapQueue>("lazy binary heap", sizeof(std::pair<WeightType, NodeType>), graph, sources, reference,
+                         repetitions);
+    Run<IndexedHeapQueue<4>>("indexed 4-ary heap", sizeof(NodeType), graph, sources, reference, repetitions);
+    Run<RadixHeapQueue>("radix heap", sizeof(unsigned long long), graph, sources, reference, repetitions);
+
+    // delta-stepping with the default bucket width on 1, 2, 4, ... threads, then narrower and wider buckets
+    const unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned t = 1;; t = std::min(2 * t, max_threads))
+    {
+        RunDeltaStepping(graph, 0, t, sources, reference, repetitions);
+        if (t == max_threads)
+            break;
+    }
+    const WeightType delta = DeltaStepping(graph, 0, 1).Delta();
+    RunDeltaStepping(graph, std::max(1u, delta / 4), max_threads, sources, reference, repetitions);
+    RunDeltaStepping(graph, delta * 4, max_threads, sources, reference, repetitions);
+    RunZeroWeights(max_threads);
+
+    // incremental repair of one tree under edge updates, checked against full recomputation
+    RunDynamicUpdates(graph, sources[0]);
+
+    // all-pairs trees, on one thread, for graphs small enough for the distance matrix
+    if (graph.size() <= FLOYD_WARSHALL_MAX_NODES)
+        RunAllPairs(graph, repetitions);
+
+    // point-to-point queries from the same sources to targets spread over the graph
+    CsrGraph reverse;
+    BuildReverseGraph(graph, reverse);
+    std::vector<std::pair<NodeType, NodeType>> queries;
+    std::vector<WeightType> lengths;
+    std::mt19937 rng(630);
+    for (size_t k = 0; k < sources.size(); k++)
+        for (int q = 0; q < 5; q++)
+        {
+            queries.push_back(std::make_pair(sources[k], (NodeType)(rng() % graph.size())));
+            lengths.push_back(reference[k].distances[queries.back().second]);
+        }
+    std::cout << queries.size() << " point-to-point queries" << std::endl;
+    // the landmark table is read from the landmark file if it was built for a graph with the same nodes, edges and
+    // weights (same CsrGraphChecksum), else built and saved there
+    LandmarkTable table;
+    if (argc > 4 && LoadLandmarks(argv[4], graph, table))
+        std::cout << "loaded " << table.landmarks.size() << " landmarks from " << argv[4] << std::endl;
+    else
+    {
+        auto start = std::chrono::steady_clock::now();
+        BuildLandmarks(graph, reverse, ALT_BENCH_LANDMARKS, table);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("built %zu landmarks in %.2f ms\n", table.landmarks.size(), seconds * 1000);
+        if (argc > 4 && !SaveLandmarks(table, argv[4]))
+            std::cout << "Cannot write the landmark file " << argv[4] << "." << std::endl;
+    }
+    RunQueries("whole tree", 0, graph, reverse, table, NULL, queries, lengths);
+    RunQueries("stop at target", 1, graph, reverse, table, NULL, queries, lengths);
+    RunQueries("reused workspace", 5, graph, reverse, table, NULL, queries, lengths);
+    RunQueries("bidirectional", 2, graph, reverse, table, NULL, queries, lengths);
+    RunQueries("ALT", 3, graph, reverse, table, NULL, queries, lengths);
+    RunQueryServer(graph, sources.size(), queries, lengths);
+
+    // the contraction hierarchy is only built on request: on random or dense graphs it takes long
+    if (argc > 5)
+    {
+        ContractionHierarchy ch;
+        auto start = std::chrono::steady_clock::now();
+        BuildContractionHierarchy(graph, ch, (unsigned)std::stoul(argv[5]));
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("built the contraction hierarchy in %.2f ms, %zu upward and %zu downward edges\n", seconds * 1000,
+                    ch.up.targets.size(), ch.down.targets.size());
+        ContractionHierarchyQuery ch_query(ch);
+        RunQueries("contraction hierarchy", 4, graph, reverse, table, &ch_query, queries, lengths);
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#include <chrono>
+
+#include "MyGraphFile_t984h395.h"
+
+// Converts a text edge list, e.g. Inputs/input_1.txt, to a binary CSR graph file that MainTest maps directly
+// usage: ./CsrConvert input.txt output.csr [threads]
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cout << "usage: " << argv[0] << " input.txt output.csr [threads]" << std::endl;
+        return 1;
+    }
+    unsigned num_threads = argc > 3 ? (unsigned)std::stoul(argv[3]) : 0;
+    auto start = std::chrono::steady_clock::now();
+    EdgeListType edges;
+    if (!LoadEdgeList(argv[1], edges, num_threads))
+    {
+        std::cout << "Cannot open the test instance file " << argv[1] << ". Abort." << std::endl;
+        return 1;
+    }
+    CsrGraph graph;
+    BuildCsrGraph(edges, graph);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!SaveCsrGraph(graph, argv[2]))
+    {
+        std::cout << "Cannot write the graph file " << argv[2] << ". Abort." << std::endl;
+        return 1;
+    }
+    std::cout << graph.size() << " nodes, " << graph.targets.size() << " edges, parsed in " << seconds * 1000
+              << " ms, written to " << argv[2] << std::endl;
+    return 0;
+}
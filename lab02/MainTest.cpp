@@ -1,4 +1,8 @@
 #include "MyDijkstra_t984h395.h"
+#include "MyFloydWarshall_t984h395.h"
+#include "MyGraphFile_t984h395.h"
+#include "MyPathMatrix_t984h395.h"
+#include "MyQueryServer_t984h395.h"
 
 void addEdge(NodeType i, NodeType j, WeightType w, GraphType &graph)
 {
@@ -7,33 +11,19 @@ void addEdge(NodeType i, NodeType j, WeightType w, GraphType &graph)
     graph[i].push_back({j, w});
 }
 
-void loadGraph(const char *fname, GraphType &g)
+void loadEdges(const char *fname, EdgeListType &edges)
 {
-    std::ifstream fin(fname);
-    if (!fin.is_open()) // fail to open
-    {
+    // the file is parsed on several threads when it is large
+    if (!LoadEdgeList(fname, edges)) // fail to open
         std::cout << "Cannot open the test instance file " << fname << ". Abort." << std::endl;
-        return;
-    }
-    else
-    {
-        while (true)
-        {
-            NodeType u, v;
-            WeightType w;
-            fin >> u;
-            if (fin.eof())
-                break;
-            fin >> v;
-            if (fin.eof())
-                break;
-            fin >> w;
-            if (fin.eof())
-                break;
-            addEdge(u, v, w, g);
-        }
-    }
-    fin.close();
+}
+
+void loadGraph(const char *fname, GraphType &g)
+{
+    EdgeListType edges;
+    loadEdges(fname, edges);
+    for (const auto &edge : edges)
+        addEdge(edge.source, edge.target, edge.weight, g);
 }
 
 // print graph, you don't need to call this when implement the Dijkstra's algorithm
@@ -53,19 +43,83 @@ void PrintPathANDLength(WeightType &path_len, std::vector<NodeType> &path)
     std::cout << path_len << "\n";
 }
 
+// Prints the shortest paths between all pairs of nodes of graph, a CsrGraph or a CsrGraphView
+// matrix: write the binary distance and predecessor matrices of MyPathMatrix_t984h395.h instead of the text paths
+template <typename Graph>
+void printAllPairs(const Graph &my_graph, unsigned num_threads, bool matrix)
+{
+    if (matrix)
+    {
+        std::string header;
+        AppendPathMatrixHeader(NodeCount(my_graph), header);
+        std::cout.write(header.data(), header.size());
+        AllPairsShortestPaths_Auto(my_graph, num_threads, AppendPathMatrixRow, std::cout);
+        return;
+    }
+    // one tree per source, from Floyd-Warshall on small dense graphs and one Dijkstra run each otherwise;
+    // the paths to all targets are read off the tree
+    AllPairsShortestPaths_Auto(my_graph, num_threads, [&my_graph](const ShortestPathTree &tree, std::string &text)
+                               {
+                                   std::vector<NodeType> path;
+                                   for (NodeType j = 0; j < NodeCount(my_graph); j++)
+                                   {
+                                       WeightType total_length;
+                                       ExtractPath(tree, j, total_length, path);
+                                       AppendPathANDLength(total_length, path, text);
+                                   } },
+                               std::cout);
+}
+
+// Answers "source target" queries on graph, read from stdin or from clients of the Unix socket at socket_path,
+// until stdin ends or the process is stopped; the stdin session ends with its stats on stderr
+template <typename Graph>
+void serveQueries(const Graph &my_graph, unsigned num_threads, const char *socket_path)
+{
+    QueryServer<Graph> server(my_graph);
+    if (socket_path)
+    {
+        if (!ServeUnixSocket(server, socket_path, num_threads))
+            std::cout << "Cannot listen on the socket " << socket_path << ". Abort." << std::endl;
+        return;
+    }
+    ServeQueries(server, STDIN_FILENO, STDOUT_FILENO);
+    std::string stats;
+    server.AppendStats(stats);
+    std::cerr << stats;
+}
+
 int main(int argc, char *argv[])
 {
-    GraphType my_graph;
-    loadGraph(argv[1], my_graph);
-    for (NodeType i = 0; i < my_graph.size(); i++)
+    // optional second argument: number of threads, one per hardware thread by default
+    unsigned num_threads = argc > 2 ? (unsigned)std::stoul(argv[2]) : 0;
+    // optional third argument "matrix": binary output, expanded back to the text paths by MatrixExpand
+    bool matrix = argc > 3 && std::string(argv[3]) == "matrix";
+    // or "serve": answer queries from stdin, or from a Unix socket at the optional fourth argument
+    bool serve = argc > 3 && std::string(argv[3]) == "serve";
+    const char *socket_path = serve && argc > 4 ? argv[4] : NULL;
+    // a binary CSR graph file written by CsrConvert is used in place, without parsing
+    if (IsCsrGraphFile(argv[1]))
     {
-        for (NodeType j = 0; j < my_graph.size(); j++)
+        MappedCsrGraph mapped;
+        if (!mapped.Open(argv[1]))
         {
-            WeightType total_length;
-            std::vector<NodeType> path;
-            ShortestPath_Dijkstra(my_graph, i, j, total_length, path);
-            PrintPathANDLength(total_length, path);
+            std::cout << "Cannot read the graph file " << argv[1] << ". Abort." << std::endl;
+            return 0;
         }
+        if (serve)
+            serveQueries(mapped.Graph(), num_threads, socket_path);
+        else
+            printAllPairs(mapped.Graph(), num_threads, matrix);
+        return 0;
     }
+    EdgeListType edges;
+    loadEdges(argv[1], edges);
+    CsrGraph my_graph;
+    BuildCsrGraph(edges, my_graph);
+    EdgeListType().swap(edges);
+    if (serve)
+        serveQueries(my_graph, num_threads, socket_path);
+    else
+        printAllPairs(my_graph, num_threads, matrix);
     return 0;
 }
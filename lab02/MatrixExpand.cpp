@@ -0,0 +1,46 @@
+#include "MyPathMatrix_t984h395.h"
+
+// Expands a binary all-pairs result written by "./Lab3 input threads matrix" into the text that
+// Lab3 prints by default, one line per source and target: the nodes of the path, then its length
+// usage: ./MatrixExpand result.bin > result.txt
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: " << argv[0] << " result.bin" << std::endl;
+        return 1;
+    }
+    std::ifstream fin(argv[1], std::ios::binary);
+    NodeType nodes;
+    if (!fin.is_open() || !ReadPathMatrixHeader(fin, nodes))
+    {
+        std::cout << "Cannot read the result file " << argv[1] << ". Abort." << std::endl;
+        return 1;
+    }
+    ShortestPathTree tree;
+    std::vector<NodeType> path;
+    std::string text;
+    for (NodeType source = 0; source < nodes; source++)
+    {
+        if (!ReadPathMatrixRow(fin, source, nodes, tree))
+        {
+            std::cerr << "The result file " << argv[1] << " ends after " << source << " rows." << std::endl;
+            return 1;
+        }
+        text.clear();
+        for (NodeType j = 0; j < nodes; j++)
+        {
+            WeightType path_len;
+            if (!ExtractMatrixPath(tree, j, path_len, path))
+            {
+                std::cout.write(text.data(), text.size());
+                std::cerr << "The result file " << argv[1] << " has no valid path from " << source << " to " << j
+                          << "." << std::endl;
+                return 1;
+            }
+            AppendPathANDLength(path_len, path, text);
+        }
+        std::cout.write(text.data(), text.size());
+    }
+    return 0;
+}
@@ -0,0 +1,279 @@
+#ifndef _MY_ALT_H_
+#define _MY_ALT_H_
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#include "MyDijkstra_t984h395.h"
+
+/*------------------------------------------------------------------------------
+ LandmarkTable
+  The preprocessing of the ALT (A*, landmarks, triangle inequality) queries:
+  the shortest distances from and to a few landmark nodes
+
+ Vairables:
+   - nodes: number of nodes of the graph the table was built for
+   - edges, checksum: number of edges and CsrGraphChecksum of that graph
+   - landmarks: the landmark nodes
+   - from: from[v * k + i] is the distance from landmark i to v, UINT_MAX if unreachable
+   - to: to[v * k + i] is the distance from v to landmark i, UINT_MAX if unreachable
+
+ Both tables are stored node by node, so the bound of a node reads one short row.
+------------------------------------------------------------------------------*/
+struct LandmarkTable
+{
+    NodeType nodes;
+    uint64_t edges;
+    uint64_t checksum;
+    std::vector<NodeType> landmarks;
+    std::vector<WeightType> from;
+    std::vector<WeightType> to;
+
+    LandmarkTable() : nodes(0), edges(0), checksum(0) {}
+};
+
+// 64-bit FNV-1a hash of the offsets, targets and weights of graph. Bounds from a table built for another graph,
+// or for this one before its weights changed, need not be lower bounds, so a table is only reused for a graph
+// with the same checksum.
+inline uint64_t CsrGraphChecksum(const CsrGraph &graph)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto add = [&hash](const void *data, size_t bytes)
+    {
+        const unsigned char *p = (const unsigned char *)data;
+        for (size_t k = 0; k < bytes; k++)
+            hash = (hash ^ p[k]) * 1099511628211ULL;
+    };
+    add(graph.offsets.data(), graph.offsets.size() * sizeof(NodeType));
+    add(graph.targets.data(), graph.targets.size() * sizeof(NodeType));
+    add(graph.weights.data(), graph.weights.size() * sizeof(WeightType));
+    return hash;
+}
+
+/*------------------------------------------------------------------------------
+ BuildLandmarks
+  Pick k landmarks by farthest-point selection and compute their distance tables
+
+ Vairables:
+   - graph: the input graph
+   - reverse: the graph built from it by BuildReverseGraph
+   - k: the number of landmarks, at most the number of nodes
+   - table: receives the landmarks and their tables
+
+ The first landmark is the node farthest from node 0; every next one is the node
+ whose distance from the closest landmark chosen so far is largest. A node that no
+ landmark reaches counts as infinitely far, so every part of the graph gets one.
+------------------------------------------------------------------------------*/
+void BuildLandmarks(
+    const CsrGraph &graph,
+    const CsrGraph &reverse,
+    unsigned k,
+    LandmarkTable &table)
+{
+    const NodeType n = graph.size();
+    k = std::min<NodeType>(k, n);
+    table.nodes = n;
+    table.edges = graph.targets.size();
+    table.checksum = CsrGraphChecksum(graph);
+    table.landmarks.clear();
+    table.from.assign((size_t)n * k, UINT_MAX);
+    table.to.assign((size_t)n * k, UINT_MAX);
+    if (k == 0)
+        return;
+
+    // nearest[v]: distance from the closest landmark so far, or from node 0 before the first one
+    ShortestPathTree tree;
+    BuildShortestPathTree(graph, 0, tree);
+    std::vector<WeightType> nearest = tree.distances;
+    std::vector<bool> chosen(n, false);
+    for (unsigned i = 0; i < k; i++)
+    {
+        NodeType landmark = UINT_MAX;
+        for (NodeType v = 0; v < n; v++)
+            if (!chosen[v] && (landmark == UINT_MAX || nearest[v] > nearest[landmark]))
+                landmark = v;
+        chosen[landmark] = true;
+        table.landmarks.push_back(landmark);
+
+        BuildShortestPathTree(graph, landmark, tree);
+        for (NodeType v = 0; v < n; v++)
+        {
+            table.from[(size_t)v * k + i] = tree.distances[v];
+            nearest[v] = i == 0 ? tree.distances[v] : std::min(nearest[v], tree.distances[v]);
+        }
+        BuildShortestPathTree(reverse, landmark, tree);
+        for (NodeType v = 0; v < n; v++)
+            table.to[(size_t)v * k + i] = tree.distances[v];
+    }
+}
+
+/*------------------------------------------------------------------------------
+ SaveLandmarks / LoadLandmarks
+  Write a landmark table to a binary file and read it back. The file holds the
+  tag "ALT2", the node count, the landmark count, the edge count and checksum of
+  the graph, the landmarks and the two tables. LoadLandmarks fails if the file
+  is not such a table or was built for a graph whose node count, edge count or
+  CsrGraphChecksum differs from graph's.
+
+------------------------------------------------------------------------------*/
+bool SaveLandmarks(const LandmarkTable &table, const char *fname)
+{
+    std::ofstream fout(fname, std::ios::binary);
+    if (!fout.is_open())
+        return false;
+    NodeType header[2] = {table.nodes, (NodeType)table.landmarks.size()};
+    uint64_t graph_id[2] = {table.edges, table.checksum};
+    fout.write("ALT2", 4);
+    fout.write((const char *)header, sizeof(header));
+    fout.write((const char *)graph_id, sizeof(graph_id));
+    fout.write((const char *)table.landmarks.data(), table.landmarks.size() * sizeof(NodeType));
+    fout.write((const char *)table.from.data(), table.from.size() * sizeof(WeightType));
+    fout.write((const char *)table.to.data(), table.to.size() * sizeof(WeightType));
+    return (bool)fout;
+}
+
+bool LoadLandmarks(const char *fname, const CsrGraph &graph, LandmarkTable &table)
+{
+    std::ifstream fin(fname, std::ios::binary);
+    char tag[4];
+    NodeType header[2];
+    uint64_t graph_id[2];
+    if (!fin.read(tag, 4) || std::memcmp(tag, "ALT2", 4) != 0 || !fin.read((char *)header, sizeof(header)) ||
+        !fin.read((char *)graph_id, sizeof(graph_id)) || header[0] != graph.size() || header[1] > header[0] ||
+        graph_id[0] != graph.targets.size() || graph_id[1] != CsrGraphChecksum(graph))
+        return false;
+    size_t cells = (size_t)header[0] * header[1];
+    table.nodes = header[0];
+    table.edges = graph_id[0];
+    table.checksum = graph_id[1];
+    table.landmarks.resize(header[1]);
+    table.from.resize(cells);
+    table.to.resize(cells);
+    fin.read((char *)table.landmarks.data(), table.landmarks.size() * sizeof(NodeType));
+    fin.read((char *)table.from.data(), cells * sizeof(WeightType));
+    fin.read((char *)table.to.data(), cells * sizeof(WeightType));
+    if (!fin)
+        return false;
+    for (NodeType landmark : table.landmarks)
+        if (landmark >= table.nodes)
+            return false;
+    return true;
+}
+
+/*------------------------------------------------------------------------------
+ LandmarkBound
+  Lower bound on the distance from v to end by the triangle inequality, using
+  every landmark L in both directions:
+    d(v, end) >= d(v, L) - d(end, L)   and   d(v, end) >= d(L, end) - d(L, v)
+  When the tables show that v cannot reach end at all, the bound is ULLONG_MAX.
+  The bound is consistent: it drops by at most w along an edge of weight w.
+
+------------------------------------------------------------------------------*/
+inline unsigned long long LandmarkBound(const LandmarkTable &table, NodeType v, NodeType end)
+{
+    const size_t k = table.landmarks.size();
+    const WeightType *from_v = table.from.data() + v * k, *to_v = table.to.data() + v * k;
+    const WeightType *from_end = table.from.data() + end * k, *to_end = table.to.data() + end * k;
+    unsigned long long bound = 0;
+    for (size_t i = 0; i < k; i++)
+    {
+        if (to_end[i] != UINT_MAX)
+        {
+            if (to_v[i] == UINT_MAX) // v cannot reach L, but end can
+                return ULLONG_MAX;
+            if (to_v[i] > to_end[i])
+                bound = std::max<unsigned long long>(bound, to_v[i] - to_end[i]);
+        }
+        if (from_v[i] != UINT_MAX)
+        {
+            if (from_end[i] == UINT_MAX) // L reaches v, but not end
+                return ULLONG_MAX;
+            if (from_end[i] > from_v[i])
+                bound = std::max<unsigned long long>(bound, from_end[i] - from_v[i]);
+        }
+    }
+    return bound;
+}
+
+/*------------------------------------------------------------------------------
+ ShortestPath_ALT
+  Find the shortest path from source to end with an A* search guided by LandmarkBound
+
+ Vairables:
+   - graph: the input graph
+   - table: the landmark table of graph
+   - source, end, path_len, path: as for ShortestPath_Dijkstra
+   - settled: if not NULL, receives the number of nodes settled by the search
+
+ The search settles every node whose distance plus bound is at most the length of
+ the shortest path, and records each node's predecessor while it relaxes edges. A
+ node takes the first settled node that improves its distance; a positive-weight
+ tight in-edge from a node with a smaller (distance, node) pair replaces it later,
+ so that with positive weights the predecessor is the node Dijkstra's algorithm
+ would have settled first and the result is exactly that of ShortestPath_Dijkstra.
+ A predecessor always has a smaller distance or was settled earlier, so zero-weight
+ ties cannot close a cycle.
+------------------------------------------------------------------------------*/
+void ShortestPath_ALT(
+    const CsrGraph &graph,
+    const LandmarkTable &table,
+    const NodeType &source,
+    const NodeType &end,
+    WeightType &path_len,
+    std::vector<NodeType> &path,
+    size_t *settled = NULL)
+{
+    typedef std::pair<unsigned long long, NodeType> Entry; // (distance + bound, node)
+    const NodeType n = graph.size();
+    std::vector<WeightType> distances(n, UINT_MAX);
+    std::vector<NodeType> previous(n, UINT_MAX);
+    std::vector<unsigned long long> bounds(n, ULLONG_MAX - 1); // ULLONG_MAX - 1: not computed yet
+    std::vector<bool> done(n, false);
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> pq;
+    size_t count = 0;
+
+    distances[source] = 0;
+    bounds[source] = LandmarkBound(table, source, end);
+    if (bounds[source] != ULLONG_MAX)
+        pq.push(Entry(bounds[source], source));
+    while (!pq.empty())
+    {
+        unsigned long long f = pq.top().first;
+        NodeType u = pq.top().second;
+        pq.pop();
+        if (distances[end] != UINT_MAX && f > distances[end])
+            break;
+        if (done[u] || f != distances[u] + bounds[u])
+            continue;
+        done[u] = true;
+        count++;
+
+        ForEachEdge(graph, u, [&](NodeType v, WeightType weight)
+                    {
+                        if (distances[u] + weight < distances[v])
+                        {
+                            if (bounds[v] == ULLONG_MAX - 1)
+                                bounds[v] = LandmarkBound(table, v, end);
+                            if (bounds[v] == ULLONG_MAX)
+                                return;
+                            distances[v] = distances[u] + weight;
+                            previous[v] = u;
+                            pq.push(Entry(distances[v] + bounds[v], v));
+                        }
+                        else if (weight > 0 && distances[u] + weight == distances[v] &&
+                                 (distances[u] < distances[previous[v]] ||
+                                  (distances[u] == distances[previous[v]] && u < previous[v])))
+                            previous[v] = u; });
+    }
+    if (settled)
+        *settled = count;
+
+    path.clear();
+    path_len = distances[end];
+    for (NodeType current = end; current != UINT_MAX; current = previous[current])
+        path.push_back(current);
+    std::reverse(path.begin(), path.end());
+}
+
+#endif
@@ -0,0 +1,549 @@
+#ifndef _MY_CONTRACTION_H_
+#define _MY_CONTRACTION_H_
+
+#include <mutex>
+
+#include "MyDijkstra_t984h395.h"
+
+const unsigned WITNESS_SETTLE_LIMIT = 256; // nodes a witness search settles before it gives up and keeps the shortcut
+
+/*------------------------------------------------------------------------------
+ ContractionHierarchy
+  A graph preprocessed for point-to-point queries: every node has a rank, and every
+  shortest path can be found as an upward path from the source followed by a
+  downward path to the target, using the original edges plus shortcuts
+
+ Vairables:
+   - rank: rank[v] is the position of v in the contraction order
+   - up: the edges v -> w with rank[w] > rank[v], stored at v
+   - down: the edges u -> v with rank[u] > rank[v], stored at v with u as the target
+   - up_middle, down_middle: for every edge of up and down, the node it shortcuts
+     (u -> middle -> w), or UINT_MAX for an edge of the input graph
+
+------------------------------------------------------------------------------*/
+struct ContractionHierarchy
+{
+    std::vector<NodeType> rank;
+    CsrGraph up;
+    CsrGraph down;
+    std::vector<NodeType> up_middle;
+    std::vector<NodeType> down_middle;
+};
+
+// An edge of the graph being contracted, as seen from one of its end nodes
+struct ContractionArc
+{
+    NodeType node;
+    WeightType weight;
+    NodeType middle;
+};
+
+// A shortcut found for a contracted node
+struct ContractionShortcut
+{
+    NodeType from;
+    NodeType to;
+    WeightType weight;
+    NodeType middle;
+};
+
+/*------------------------------------------------------------------------------
+ WitnessSearch
+  The per-thread state of the witness searches: a Dijkstra search that is reset
+  through the list of the nodes it touched, so that one search costs only what it
+  explores
+
+------------------------------------------------------------------------------*/
+class WitnessSearch
+{
+public:
+    explicit WitnessSearch(NodeType n) : distances_(n, UINT_MAX), via_(n, UINT_MAX) {}
+
+    // Finds the shortcuts needed to contract v: for every in-edge u -> v and out-edge v -> w,
+    // u -> w is needed unless a path from u to w avoiding v and the excluded nodes is at most as long.
+    // Calls found(u, w, weight) for every shortcut needed.
+    template <typename Found>
+    void Shortcuts(
+        NodeType v,
+        const std::vector<std::vector<ContractionArc>> &out,
+        const std::vector<std::vector<ContractionArc>> &in,
+        const std::vector<char> &excluded,
+        Found found)
+    {
+        for (const auto &first : in[v])
+        {
+            const NodeType u = first.node;
+            // via_[w]: the length of u -> v -> w; a path longer than UINT_MAX cannot be reported, so it is never needed
+            WeightType limit = 0;
+            size_t open = 0;
+            for (const auto &second : out[v])
+            {
+                unsigned long long weight = (unsigned long long)first.weight + second.weight;
+                if (second.node == u || weight >= UINT_MAX)
+                    continue;
+                via_[second.node] = (WeightType)weight;
+                limit = std::max(limit, (WeightType)weight);
+                open++;
+            }
+            if (open > 0)
+                Search(u, v, limit, open, out, excluded);
+            for (const auto &second : out[v])
+                if (via_[second.node] != UINT_MAX)
+                {
+                    if (distances_[second.node] > via_[second.node])
+                        found(u, second.node, via_[second.node]);
+                    via_[second.node] = UINT_MAX;
+                }
+            Clear();
+        }
+    }
+
+private:
+    // Dijkstra from source, avoiding avoid and the excluded nodes, up to distance limit and WITNESS_SETTLE_LIMIT
+    // settled nodes; stops early once each of the open targets (via_ set) has a path no longer than its via_
+    void Search(
+        NodeType source,
+        NodeType avoid,
+        WeightType limit,
+        size_t open,
+        const std::vector<std::vector<ContractionArc>> &out,
+        const std::vector<char> &excluded)
+    {
+        Touch(source, 0);
+        heap_.push_back(std::make_pair(0, source));
+        unsigned settled = 0;
+        while (!heap_.empty() && settled < WITNESS_SETTLE_LIMIT)
+        {
+            std::pop_heap(heap_.begin(), heap_.end(), std::greater<std::pair<WeightType, NodeType>>());
+            WeightType dist = heap_.back().first;
+            NodeType u = heap_.back().second;
+            heap_.pop_back();
+            if (dist != distances_[u])
+                continue;
+            if (dist > limit)
+                break;
+            settled++;
+            for (const auto &arc : out[u])
+            {
+                if (arc.node == avoid || excluded[arc.node])
+                    continue;
+                unsigned long long next = (unsigned long long)dist + arc.weight;
+                if (next <= limit && next < distances_[arc.node])
+                {
+                    // a target counts as witnessed the first time its distance drops to its via_ length
+                    if (next <= via_[arc.node] && distances_[arc.node] > via_[arc.node] && --open == 0)
+                    {
+                        Touch(arc.node, (WeightType)next);
+                        heap_.clear();
+                        return;
+                    }
+                    Touch(arc.node, (WeightType)next);
+                    heap_.push_back(std::make_pair((WeightType)next, arc.node));
+                    std::push_heap(heap_.begin(), heap_.end(), std::greater<std::pair<WeightType, NodeType>>());
+                }
+            }
+        }
+        heap_.clear();
+    }
+
+    void Touch(NodeType v, WeightType dist)
+    {
+        if (distances_[v] == UINT_MAX)
+            touched_.push_back(v);
+        distances_[v] = dist;
+    }
+
+    void Clear()
+    {
+        for (NodeType v : touched_)
+            distances_[v] = UINT_MAX;
+        touched_.clear();
+    }
+
+    std::vector<WeightType> distances_;
+    std::vector<WeightType> via_; // UINT_MAX for nodes that are not targets of the current search
+    std::vector<NodeType> touched_;
+    std::vector<std::pair<WeightType, NodeType>> heap_;
+};
+
+// Adds the edge from -> to to the graph being contracted, or lowers the weight of the existing one
+inline void AddContractionArc(
+    std::vector<std::vector<ContractionArc>> &out,
+    std::vector<std::vector<ContractionArc>> &in,
+    NodeType from, NodeType to, WeightType weight, NodeType middle)
+{
+    for (auto &arc : out[from])
+        if (arc.node == to)
+        {
+            if (weight < arc.weight)
+            {
+                arc.weight = weight;
+                arc.middle = middle;
+                for (auto &back : in[to])
+                    if (back.node == from)
+                    {
+                        back.weight = weight;
+                        back.middle = middle;
+                    }
+            }
+            return;
+        }
+    out[from].push_back({to, weight, middle});
+    in[to].push_back({from, weight, middle});
+}
+
+// Removes the edges between v and node from the list of node
+inline void RemoveContractionArc(std::vector<ContractionArc> &arcs, NodeType v)
+{
+    for (size_t k = 0; k < arcs.size(); k++)
+        if (arcs[k].node == v)
+        {
+            arcs[k] = arcs.back();
+            arcs.pop_back();
+            return;
+        }
+}
+
+// Packs the contraction edges of all nodes into a CsrGraph and its middle nodes
+inline void PackContractionArcs(const std::vector<std::vector<ContractionArc>> &arcs, CsrGraph &graph,
+                                std::vector<NodeType> &middle)
+{
+    graph.offsets.assign(1, 0);
+    graph.targets.clear();
+    graph.weights.clear();
+    middle.clear();
+    for (const auto &list : arcs)
+    {
+        for (const auto &arc : list)
+        {
+            graph.targets.push_back(arc.node);
+            graph.weights.push_back(arc.weight);
+            middle.push_back(arc.middle);
+        }
+        graph.offsets.push_back((NodeType)graph.targets.size());
+    }
+}
+
+/*------------------------------------------------------------------------------
+ BuildContractionHierarchy
+  Contract the nodes of graph one level at a time and collect the hierarchy
+
+ Vairables:
+   - graph: the input graph, a GraphType or a CsrGraph
+   - ch: receives the hierarchy
+   - num_threads: number of threads; 0 means one per hardware thread
+
+ A node's priority is its edge difference (shortcuts it needs minus edges it
+ removes) plus the number of its neighbors already contracted. All priorities are
+ first computed in parallel. Each round then contracts the nodes whose
+ (priority, node) is smaller than that of every remaining neighbor.
+
+ Contracting a node only bumps the priority of its neighbors and marks them stale.
+ A stale node is simulated again, in parallel with the others, when it becomes
+ such a local minimum, and it is contracted only if it still is one. The nodes of
+ a round are pairwise independent, so their witness searches also run in
+ parallel. These searches avoid every node contracted so far or in the same
+ round, which may add a few shortcuts but never misses one. The shortcuts are
+ then inserted on one thread.
+------------------------------------------------------------------------------*/
+template <typename Graph>
+void BuildContractionHierarchy(
+    const Graph &graph,
+    ContractionHierarchy &ch,
+    unsigned num_threads = 0)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    const NodeType n = NodeCount(graph);
+    std::vector<std::vector<ContractionArc>> out(n), in(n), up(n), down(n);
+    for (NodeType u = 0; u < n; u++)
+        ForEachEdge(graph, u, [&](NodeType v, WeightType weight)
+                    {
+                        if (u != v) // a self loop is never on a shortest path
+                            AddContractionArc(out, in, u, v, weight, UINT_MAX); });
+
+    std::vector<WitnessSearch> searches(num_threads, WitnessSearch(n));
+    std::vector<char> contracted(n, 0);
+    std::vector<int> priority(n, 0), contracted_neighbors(n, 0);
+    std::vector<char> stale(n, 0);
+    auto computePriority = [&](NodeType v, unsigned thread)
+    {
+        int shortcuts = 0;
+        searches[thread].Shortcuts(v, out, in, contracted, [&](NodeType, NodeType, WeightType)
+                                   { shortcuts++; });
+        priority[v] = shortcuts - (int)(in[v].size() + out[v].size()) + contracted_neighbors[v];
+        stale[v] = 0;
+    };
+    // true if v comes before all of its remaining neighbors
+    auto isLocalMinimum = [&](NodeType v)
+    {
+        for (int side = 0; side < 2; side++)
+            for (const auto &arc : side == 0 ? out[v] : in[v])
+            {
+                NodeType u = arc.node;
+                if (priority[u] < priority[v] || (priority[u] == priority[v] && u < v))
+                    return false;
+            }
+        return true;
+    };
+    ParallelFor(n, num_threads, [&](size_t v, unsigned thread)
+                { computePriority((NodeType)v, thread); });
+
+    ch.rank.assign(n, UINT_MAX);
+    std::vector<NodeType> remaining(n), candidates, refresh, batch;
+    for (NodeType v = 0; v < n; v++)
+        remaining[v] = v;
+    std::vector<std::vector<ContractionShortcut>> shortcuts;
+    NodeType next_rank = 0;
+    while (!remaining.empty())
+    {
+        candidates.clear();
+        refresh.clear();
+        for (NodeType v : remaining)
+            if (isLocalMinimum(v))
+            {
+                candidates.push_back(v);
+                if (stale[v])
+                    refresh.push_back(v);
+            }
+        // candidates are not adjacent, so refreshing one does not change what the others are compared with
+        ParallelFor(refresh.size(), num_threads, [&](size_t k, unsigned thread)
+                    { computePriority(refresh[k], thread); });
+        batch.clear();
+        for (NodeType v : candidates)
+            if (refresh.empty() || isLocalMinimum(v))
+                batch.push_back(v);
+        if (batch.empty())
+            continue;
+        for (NodeType v : batch)
+            contracted[v] = 1;
+
+        shortcuts.assign(batch.size(), std::vector<ContractionShortcut>());
+        ParallelFor(batch.size(), num_threads, [&](size_t k, unsigned thread)
+                    {
+                        NodeType v = batch[k];
+                        searches[thread].Shortcuts(v, out, in, contracted, [&](NodeType u, NodeType w, WeightType weight)
+                                                   { shortcuts[k].push_back({u, w, weight, v}); }); });
+
+        for (NodeType v : batch)
+        {
+            ch.rank[v] = next_rank++;
+            up[v].swap(out[v]);
+            down[v].swap(in[v]);
+            for (const auto &arc : up[v])
+                RemoveContractionArc(in[arc.node], v);
+            for (const auto &arc : down[v])
+                RemoveContractionArc(out[arc.node], v);
+            for (int side = 0; side < 2; side++)
+                for (const auto &arc : side == 0 ? up[v] : down[v])
+                {
+                    contracted_neighbors[arc.node]++;
+                    priority[arc.node]++;
+                    stale[arc.node] = 1;
+                }
+        }
+        for (const auto &list : shortcuts)
+            for (const auto &shortcut : list)
+                AddContractionArc(out, in, shortcut.from, shortcut.to, shortcut.weight, shortcut.middle);
+
+        size_t kept = 0;
+        for (NodeType v : remaining)
+            if (!contracted[v])
+                remaining[kept++] = v;
+        remaining.resize(kept);
+    }
+
+    PackContractionArcs(up, ch.up, ch.up_middle);
+    PackContractionArcs(down, ch.down, ch.down_middle);
+}
+
+/*------------------------------------------------------------------------------
+ ContractionHierarchyQuery
+  Point-to-point queries on a ContractionHierarchy. The object keeps the search
+  state between queries and resets only the nodes a query touched, so a query
+  costs only the part of the hierarchy it explores. Use one object per thread.
+
+------------------------------------------------------------------------------*/
+class ContractionHierarchyQuery
+{
+public:
+    explicit ContractionHierarchyQuery(const ContractionHierarchy &ch) : ch_(ch)
+    {
+        for (int side = 0; side < 2; side++)
+        {
+            distances_[side].assign(ch.rank.size(), UINT_MAX);
+            arcs_[side].assign(ch.rank.size(), UINT_MAX);
+        }
+    }
+
+    /*--------------------------------------------------------------------------
+     ShortestPath
+      Find the shortest path from source to end with an upward search from source
+      and an upward search over the reversed edges from end; each one stops once
+      its smallest key reaches the best meeting distance found. Shortcuts on the
+      resulting path are then unpacked into the nodes they stand for.
+
+     Vairables:
+       - source, end, path_len, path: as for ShortestPath_Dijkstra; the length is
+         the same, and on ties the path may differ
+       - settled: if not NULL, receives the number of nodes settled by both searches
+
+    --------------------------------------------------------------------------*/
+    void ShortestPath(
+        const NodeType &source,
+        const NodeType &end,
+        WeightType &path_len,
+        std::vector<NodeType> &path,
+        size_t *settled = NULL)
+    {
+        const CsrGraph *graphs[2] = {&ch_.up, &ch_.down};
+        unsigned long long best = ULLONG_MAX;
+        NodeType meet = UINT_MAX;
+        size_t count = 0;
+        Touch(0, source, 0, UINT_MAX);
+        Touch(1, end, 0, UINT_MAX);
+        heaps_[0].push_back(std::make_pair(0, source));
+        heaps_[1].push_back(std::make_pair(0, end));
+
+        for (int side = 0; !heaps_[0].empty() || !heaps_[1].empty(); side = 1 - side)
+        {
+            std::vector<std::pair<WeightType, NodeType>> &heap = heaps_[side];
+            if (heap.empty())
+                continue;
+            std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<WeightType, NodeType>>());
+            WeightType dist = heap.back().first;
+            NodeType u = heap.back().second;
+            heap.pop_back();
+            if (dist != distances_[side][u])
+                continue;
+            if (dist >= best)
+            {
+                heap.clear(); // this side cannot improve on best any more
+                continue;
+            }
+            count++;
+            if (distances_[1 - side][u] != UINT_MAX && (unsigned long long)dist + distances_[1 - side][u] < best)
+            {
+                best = (unsigned long long)dist + distances_[1 - side][u];
+                meet = u;
+            }
+            const CsrGraph &graph = *graphs[side];
+            for (NodeType k = graph.offsets[u]; k < graph.offsets[u + 1]; k++)
+            {
+                NodeType v = graph.targets[k];
+                WeightType next = dist + graph.weights[k];
+                if (next < distances_[side][v])
+                {
+                    Touch(side, v, next, k);
+                    heap.push_back(std::make_pair(next, v));
+                    std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<WeightType, NodeType>>());
+                }
+            }
+        }
+        if (settled)
+            *settled = count;
+
+        path.clear();
+        if (meet == UINT_MAX)
+        {
+            // unreachable: the same result as ShortestPath_Dijkstra
+            path_len = UINT_MAX;
+            path.push_back(end);
+        }
+        else
+        {
+            path_len = (WeightType)best;
+            // the edges of the upward half, from source to meet, then those of the downward half to end
+            std::vector<ContractionShortcut> edges;
+            for (NodeType v = meet; v != source;)
+            {
+                NodeType k = arcs_[0][v], from = Tail(0, k);
+                edges.push_back(ContractionShortcut{from, v, ch_.up.weights[k], ch_.up_middle[k]});
+                v = from;
+            }
+            std::reverse(edges.begin(), edges.end());
+            for (NodeType v = meet; v != end;)
+            {
+                NodeType k = arcs_[1][v], to = Tail(1, k);
+                edges.push_back(ContractionShortcut{v, to, ch_.down.weights[k], ch_.down_middle[k]});
+                v = to;
+            }
+            path.push_back(source);
+            for (const auto &edge : edges)
+                Unpack(edge, path);
+        }
+        Clear();
+    }
+
+private:
+    // The node whose edge list in the search graph of side holds edge k
+    NodeType Tail(int side, NodeType k) const
+    {
+        const std::vector<NodeType> &offsets = side == 0 ? ch_.up.offsets : ch_.down.offsets;
+        return (NodeType)(std::upper_bound(offsets.begin(), offsets.end(), k) - offsets.begin() - 1);
+    }
+
+    // Appends the nodes after edge.from on the input graph path that the edge stands for
+    void Unpack(const ContractionShortcut &edge, std::vector<NodeType> &path) const
+    {
+        // the edges still to expand, the next one on top
+        std::vector<ContractionShortcut> stack(1, edge);
+        while (!stack.empty())
+        {
+            ContractionShortcut top = stack.back();
+            stack.pop_back();
+            if (top.middle == UINT_MAX)
+            {
+                path.push_back(top.to);
+                continue;
+            }
+            // when the middle node was contracted, from -> middle went to down[middle] and middle -> to to up[middle]
+            const NodeType m = top.middle;
+            ContractionShortcut first = {top.from, m, 0, UINT_MAX}, second = {m, top.to, 0, UINT_MAX};
+            for (NodeType k = ch_.down.offsets[m]; k < ch_.down.offsets[m + 1]; k++)
+                if (ch_.down.targets[k] == top.from)
+                {
+                    first.weight = ch_.down.weights[k];
+                    first.middle = ch_.down_middle[k];
+                }
+            for (NodeType k = ch_.up.offsets[m]; k < ch_.up.offsets[m + 1]; k++)
+                if (ch_.up.targets[k] == top.to)
+                {
+                    second.weight = ch_.up.weights[k];
+                    second.middle = ch_.up_middle[k];
+                }
+            stack.push_back(second);
+            stack.push_back(first);
+        }
+    }
+
+    void Touch(int side, NodeType v, WeightType dist, NodeType arc)
+    {
+        if (distances_[side][v] == UINT_MAX)
+            touched_[side].push_back(v);
+        distances_[side][v] = dist;
+        arcs_[side][v] = arc;
+    }
+
+    void Clear()
+    {
+        for (int side = 0; side < 2; side++)
+        {
+            for (NodeType v : touched_[side])
+            {
+                distances_[side][v] = UINT_MAX;
+                arcs_[side][v] = UINT_MAX;
+            }
+            touched_[side].clear();
+            heaps_[side].clear();
+        }
+    }
+
+    const ContractionHierarchy &ch_;
+    std::vector<WeightType> distances_[2];
+    std::vector<NodeType> arcs_[2]; // the search graph edge each node was reached by
+    std::vector<NodeType> touched_[2];
+    std::vector<std::pair<WeightType, NodeType>> heaps_[2];
+};
+
+#endif
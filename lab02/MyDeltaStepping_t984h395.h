@@ -0,0 +1,342 @@
+#ifndef _MY_DELTA_STEPPING_H_
+#define _MY_DELTA_STEPPING_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "MyDijkstra_t984h395.h"
+
+const size_t DELTA_STEPPING_CHUNK = 64;         // frontier nodes a thread takes from the shared counter at a time
+const size_t DELTA_STEPPING_MAX_BUCKETS = 1 << 16; // at most this many buckets per thread; delta is raised to fit
+
+// Blocks the threads of a run until all of them have called Wait
+class ThreadBarrier
+{
+public:
+    explicit ThreadBarrier(unsigned count) : count_(count), waiting_(0), generation_(0) {}
+
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const unsigned generation = generation_;
+        if (++waiting_ == count_)
+        {
+            waiting_ = 0;
+            generation_++;
+            condition_.notify_all();
+        }
+        else
+            condition_.wait(lock, [&]
+                            { return generation != generation_; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    unsigned count_;
+    unsigned waiting_;
+    unsigned generation_;
+};
+
+/*------------------------------------------------------------------------------
+ DeltaStepping
+  Single-source shortest paths on several threads with the delta-stepping
+  algorithm. The object keeps its own copy of the graph with the light edges
+  (weight <= delta) of every node stored before the heavy ones, and its
+  per-thread buckets, so that repeated runs reuse them. Use one object per
+  concurrent caller.
+
+  Tentative distances never run more than the largest weight ahead of the
+  current bucket, so the buckets form a cyclic array of largest weight / delta
+  + 2 entries, whatever the lengths of the paths.
+
+ Vairables:
+   - graph: the input graph, a GraphType or a CsrGraph
+   - delta: the bucket width; 0 picks the largest weight divided by the average out-degree. It is raised
+     if the cyclic array would need more than DELTA_STEPPING_MAX_BUCKETS buckets
+   - num_threads: number of threads; 0 means one per hardware thread
+
+------------------------------------------------------------------------------*/
+class DeltaStepping
+{
+public:
+    template <typename Graph>
+    DeltaStepping(const Graph &graph, WeightType delta = 0, unsigned num_threads = 0)
+        : delta_(delta), num_threads_(num_threads), zero_weights_(false)
+    {
+        if (num_threads_ == 0)
+            num_threads_ = std::max(1u, std::thread::hardware_concurrency());
+        const NodeType n = NodeCount(graph);
+        WeightType max_weight = 0;
+        size_t edges = 0;
+        for (NodeType u = 0; u < n; u++)
+            ForEachEdge(graph, u, [&](NodeType, WeightType weight)
+                        {
+                            max_weight = std::max(max_weight, weight);
+                            zero_weights_ = zero_weights_ || weight == 0;
+                            edges++; });
+        if (delta_ == 0)
+            delta_ = std::max<WeightType>(1, (WeightType)(max_weight / std::max<size_t>(1, edges / std::max(1u, n))));
+        if (max_weight / delta_ + 2 > DELTA_STEPPING_MAX_BUCKETS)
+            delta_ = (WeightType)(max_weight / (DELTA_STEPPING_MAX_BUCKETS - 2) + 1);
+
+        graph_.offsets.assign(1, 0);
+        graph_.targets.reserve(edges);
+        graph_.weights.reserve(edges);
+        light_end_.resize(n);
+        for (NodeType u = 0; u < n; u++)
+        {
+            for (int heavy = 0; heavy < 2; heavy++)
+            {
+                ForEachEdge(graph, u, [&](NodeType v, WeightType weight)
+                            {
+                                if ((weight > delta_) == (heavy == 1))
+                                {
+                                    graph_.targets.push_back(v);
+                                    graph_.weights.push_back(weight);
+                                } });
+                if (heavy == 0)
+                    light_end_[u] = (NodeType)graph_.targets.size();
+            }
+            graph_.offsets.push_back((NodeType)graph_.targets.size());
+        }
+
+        distances_.reset(new std::atomic<WeightType>[n]);
+        processed_.reset(new std::atomic<WeightType>[n]);
+        parents_.reset(new std::atomic<unsigned long long>[n]);
+        bins_.assign(num_threads_, std::vector<std::vector<NodeType>>(max_weight / delta_ + 2));
+        settled_.resize(num_threads_);
+    }
+
+    WeightType Delta() const { return delta_; }
+    unsigned Threads() const { return num_threads_; }
+
+    /*--------------------------------------------------------------------------
+     BuildShortestPathTree
+      Compute the shortest path tree from source. Bucket b holds the nodes whose
+      tentative distance is in [b * delta, (b + 1) * delta), in entry b modulo the
+      number of buckets of the cyclic array. The smallest non-empty
+      bucket is emptied in phases that relax the light edges of its nodes in
+      parallel, until no node falls back into it; then the heavy edges of all
+      the nodes it settled are relaxed once. Distances are lowered with an atomic
+      compare-and-swap minimum, and each thread files the nodes it improved in
+      its own buckets, which are merged when the next phase starts.
+
+      The distances are those of BuildShortestPathTree in MyDijkstra_t984h395.h.
+      The predecessors are then chosen in one more parallel pass: among the edges
+      u -> v with distances[u] + weight == distances[v], the one with the smallest
+      (distances[u], u) wins through an atomic minimum on the two packed in 64
+      bits. That is the edge Dijkstra's algorithm keeps, since it settles the
+      nodes in that order, so for positive weights the whole tree is the same.
+      Zero weights break that order: nodes at the same distance may pick each
+      other and close a cycle. A graph with zero-weight edges is therefore run by
+      the serial BuildShortestPathTree instead, which keeps the predecessors in
+      settle order.
+
+     Vairables:
+       - source: the source node
+       - tree: receives the distances and predecessors of all nodes
+
+    --------------------------------------------------------------------------*/
+    void BuildShortestPathTree(const NodeType &source, ShortestPathTree &tree)
+    {
+        const NodeType n = graph_.size();
+        if (zero_weights_)
+        {
+            ::BuildShortestPathTree(graph_, source, tree);
+            return;
+        }
+        tree.source = source;
+        tree.distances.resize(n);
+        tree.previous.resize(n);
+        ThreadBarrier barrier(num_threads_);
+
+        auto worker = [&](unsigned thread)
+        {
+            // the O(n) passes give every thread its own slice of the nodes
+            const NodeType first = (NodeType)((unsigned long long)n * thread / num_threads_);
+            const NodeType last = (NodeType)((unsigned long long)n * (thread + 1) / num_threads_);
+            for (NodeType v = first; v < last; v++)
+            {
+                distances_[v].store(UINT_MAX, std::memory_order_relaxed);
+                processed_[v].store(UINT_MAX, std::memory_order_relaxed);
+                parents_[v].store(ULLONG_MAX, std::memory_order_relaxed);
+            }
+            barrier.Wait();
+            if (thread == 0)
+            {
+                distances_[source].store(0, std::memory_order_relaxed);
+                frontier_.assign(1, source);
+                bucket_ = 0;
+                next_ = 0;
+            }
+            barrier.Wait();
+
+            while (!frontier_.empty())
+            {
+                // light phases: repeat until the current bucket stays empty
+                while (!frontier_.empty())
+                {
+                    for (size_t k = next_.fetch_add(DELTA_STEPPING_CHUNK); k < frontier_.size();
+                         k = next_.fetch_add(DELTA_STEPPING_CHUNK))
+                    {
+                        for (size_t i = k; i < std::min(k + DELTA_STEPPING_CHUNK, frontier_.size()); i++)
+                        {
+                            const NodeType u = frontier_[i];
+                            const WeightType dist = distances_[u].load(std::memory_order_relaxed);
+                            // the entry was left behind in a later bucket when u moved to an earlier one
+                            if (dist / delta_ != bucket_)
+                                continue;
+                            // u may have been filed several times at this distance; only one thread relaxes it
+                            const WeightType before = processed_[u].exchange(dist, std::memory_order_relaxed);
+                            if (before == dist)
+                                continue;
+                            if (before == UINT_MAX || before / delta_ != bucket_)
+                                settled_[thread].push_back(u);
+                            Relax(dist, graph_.offsets[u], light_end_[u], thread);
+                        }
+                    }
+                    barrier.Wait();
+                    if (thread == 0)
+                        TakeBucket(bucket_);
+                    barrier.Wait();
+                }
+
+                // heavy phase: the nodes settled in this bucket have their final distances now
+                for (NodeType u : settled_[thread])
+                {
+                    const WeightType dist = distances_[u].load(std::memory_order_relaxed);
+                    Relax(dist, light_end_[u], graph_.offsets[u + 1], thread);
+                }
+                settled_[thread].clear();
+                barrier.Wait();
+                if (thread == 0)
+                {
+                    // the live entries are at most one lap of the cyclic array ahead of the current bucket
+                    size_t next_bucket = SIZE_MAX;
+                    const size_t count = bins_[0].size();
+                    for (size_t b = bucket_ + 1; b < bucket_ + count && next_bucket == SIZE_MAX; b++)
+                        for (const auto &bins : bins_)
+                            if (!bins[b % count].empty())
+                            {
+                                next_bucket = b;
+                                break;
+                            }
+                    if (next_bucket != SIZE_MAX)
+                        TakeBucket(next_bucket);
+                }
+                barrier.Wait();
+            }
+
+            for (NodeType u = first; u < last; u++)
+            {
+                const WeightType dist = distances_[u].load(std::memory_order_relaxed);
+                if (dist == UINT_MAX)
+                    continue;
+                const unsigned long long key = (unsigned long long)dist << 32 | u;
+                for (NodeType k = graph_.offsets[u]; k < graph_.offsets[u + 1]; k++)
+                {
+                    const NodeType v = graph_.targets[k];
+                    if (v == source || (unsigned long long)dist + graph_.weights[k] !=
+                                           distances_[v].load(std::memory_order_relaxed))
+                        continue;
+                    unsigned long long old = parents_[v].load(std::memory_order_relaxed);
+                    while (key < old && !parents_[v].compare_exchange_weak(old, key, std::memory_order_relaxed))
+                    {
+                    }
+                }
+            }
+            barrier.Wait();
+            for (NodeType v = first; v < last; v++)
+            {
+                const unsigned long long parent = parents_[v].load(std::memory_order_relaxed);
+                tree.distances[v] = distances_[v].load(std::memory_order_relaxed);
+                tree.previous[v] = parent == ULLONG_MAX ? UINT_MAX : (NodeType)(parent & UINT_MAX);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned t = 1; t < num_threads_; t++)
+            threads.push_back(std::thread(worker, t));
+        worker(0);
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+private:
+    // Relaxes the edges begin ... end - 1 of a node at distance dist
+    void Relax(WeightType dist, NodeType begin, NodeType end, unsigned thread)
+    {
+        std::vector<std::vector<NodeType>> &bins = bins_[thread];
+        for (NodeType k = begin; k < end; k++)
+        {
+            const unsigned long long next = (unsigned long long)dist + graph_.weights[k];
+            if (next >= UINT_MAX)
+                continue;
+            const NodeType v = graph_.targets[k];
+            WeightType old = distances_[v].load(std::memory_order_relaxed);
+            while (next < old && !distances_[v].compare_exchange_weak(old, (WeightType)next, std::memory_order_relaxed))
+            {
+            }
+            if (next < old)
+                bins[(size_t)(next / delta_) % bins.size()].push_back(v);
+        }
+    }
+
+    // Makes bucket b of all threads the next frontier; called by one thread between barriers
+    void TakeBucket(size_t b)
+    {
+        bucket_ = b;
+        frontier_.clear();
+        for (auto &bins : bins_)
+        {
+            std::vector<NodeType> &bin = bins[b % bins.size()];
+            frontier_.insert(frontier_.end(), bin.begin(), bin.end());
+            bin.clear();
+        }
+        next_ = 0;
+    }
+
+    CsrGraph graph_;
+    std::vector<NodeType> light_end_; // light_end_[u]: the end of u's light edges and the start of its heavy ones
+    WeightType delta_;
+    unsigned num_threads_;
+    bool zero_weights_; // some edge weighs 0, so the predecessors come from the serial BuildShortestPathTree
+    std::unique_ptr<std::atomic<WeightType>[]> distances_;
+    std::unique_ptr<std::atomic<WeightType>[]> processed_;      // the distance u's light edges were last relaxed at
+    std::unique_ptr<std::atomic<unsigned long long>[]> parents_; // (distances[u] << 32 | u) of the chosen predecessor
+    std::vector<std::vector<std::vector<NodeType>>> bins_;       // bins_[thread][b % count]: nodes a thread filed in bucket b
+    std::vector<std::vector<NodeType>> settled_;                 // per thread, the nodes settled in the current bucket
+    std::vector<NodeType> frontier_;
+    size_t bucket_;
+    std::atomic<size_t> next_;
+};
+
+/*------------------------------------------------------------------------------
+ ShortestPath_DeltaStepping
+  Find the shortest path from source to end with a parallel delta-stepping run
+
+ Vairables:
+   - graph, source, end, path_len, path: as for ShortestPath_Dijkstra, with the same result
+   - delta, num_threads: as for DeltaStepping
+
+------------------------------------------------------------------------------*/
+template <typename Graph>
+void ShortestPath_DeltaStepping(
+    const Graph &graph,
+    const NodeType &source,
+    const NodeType &end,
+    WeightType &path_len,
+    std::vector<NodeType> &path,
+    WeightType delta = 0,
+    unsigned num_threads = 0)
+{
+    DeltaStepping engine(graph, delta, num_threads);
+    ShortestPathTree tree;
+    engine.BuildShortestPathTree(source, tree);
+    ExtractPath(tree, end, path_len, path);
+}
+
+#endif
@@ -9,11 +9,546 @@
 #include <stack>
 #include <utility>
 #include <algorithm>
+#include <string>
+#include <thread>
+#include <atomic>
 
 typedef unsigned int NodeType;
 typedef unsigned int WeightType;
 typedef std::vector<std::vector<std::pair<NodeType, WeightType>>> GraphType; // graph as adjacent list
 
+struct EdgeType
+{
+    NodeType source;
+    NodeType target;
+    WeightType weight;
+};
+typedef std::vector<EdgeType> EdgeListType; // graph as list of edges, e.g. in the order of the input file
+
+const unsigned APSP_SOURCES_PER_THREAD = 64; // sources per thread in one batch of the parallel all-pairs run
+
+/*------------------------------------------------------------------------------
+ CsrGraph
+  The graph in compressed sparse row form: the out-edges of node u are
+  targets[offsets[u]] ... targets[offsets[u + 1] - 1] with the matching weights,
+  in the same order as in the adjacency list
+
+ Vairables:
+   - offsets: size() + 1 entries, the start of every node's edges and the total edge count last
+   - targets: the target node of every edge
+   - weights: the weight of every edge
+
+------------------------------------------------------------------------------*/
+struct CsrGraph
+{
+    std::vector<NodeType> offsets;
+    std::vector<NodeType> targets;
+    std::vector<WeightType> weights;
+
+    CsrGraph() : offsets(1, 0) {}
+    NodeType size() const { return (NodeType)offsets.size() - 1; }
+};
+
+/*------------------------------------------------------------------------------
+ BuildCsrGraph
+  Convert an adjacency list graph to a CsrGraph in one linear pass
+
+------------------------------------------------------------------------------*/
+void BuildCsrGraph(const GraphType &graph, CsrGraph &csr)
+{
+    size_t edges = 0;
+    for (const auto &list : graph)
+        edges += list.size();
+    csr.offsets.assign(1, 0);
+    csr.offsets.reserve(graph.size() + 1);
+    csr.targets.clear();
+    csr.targets.reserve(edges);
+    csr.weights.clear();
+    csr.weights.reserve(edges);
+    for (const auto &list : graph)
+    {
+        for (const auto &edge : list)
+        {
+            csr.targets.push_back(edge.first);
+            csr.weights.push_back(edge.second);
+        }
+        csr.offsets.push_back((NodeType)csr.targets.size());
+    }
+}
+
+/*------------------------------------------------------------------------------
+ BuildCsrGraph
+  Build a CsrGraph straight from an edge list with a counting sort on the
+  source node; edges with the same source keep their order in the list
+
+ Vairables:
+   - edges: the edge list
+   - csr: receives the graph; it has as many nodes as the largest source + 1, like addEdge builds
+
+------------------------------------------------------------------------------*/
+void BuildCsrGraph(const EdgeListType &edges, CsrGraph &csr)
+{
+    NodeType n = 0;
+    for (const auto &edge : edges)
+        n = std::max(n, edge.source + 1);
+    csr.offsets.assign(n + 1, 0);
+    for (const auto &edge : edges)
+        csr.offsets[edge.source + 1]++;
+    for (NodeType u = 0; u < n; u++)
+        csr.offsets[u + 1] += csr.offsets[u];
+    csr.targets.resize(edges.size());
+    csr.weights.resize(edges.size());
+    std::vector<NodeType> fill(csr.offsets.begin(), csr.offsets.end() - 1);
+    for (const auto &edge : edges)
+    {
+        NodeType k = fill[edge.source]++;
+        csr.targets[k] = edge.target;
+        csr.weights[k] = edge.weight;
+    }
+}
+
+/*------------------------------------------------------------------------------
+ BuildReverseGraph
+  Build the graph with every edge of graph reversed, for searches that run
+  backward from a target; the in-edges of a node are ordered by source node
+
+------------------------------------------------------------------------------*/
+void BuildReverseGraph(const CsrGraph &graph, CsrGraph &reverse)
+{
+    const NodeType n = graph.size();
+    reverse.offsets.assign(n + 1, 0);
+    for (NodeType v : graph.targets)
+        reverse.offsets[v + 1]++;
+    for (NodeType v = 0; v < n; v++)
+        reverse.offsets[v + 1] += reverse.offsets[v];
+    reverse.targets.resize(graph.targets.size());
+    reverse.weights.resize(graph.weights.size());
+    std::vector<NodeType> fill(reverse.offsets.begin(), reverse.offsets.end() - 1);
+    for (NodeType u = 0; u < n; u++)
+        for (NodeType k = graph.offsets[u]; k < graph.offsets[u + 1]; k++)
+        {
+            NodeType j = fill[graph.targets[k]]++;
+            reverse.targets[j] = u;
+            reverse.weights[j] = graph.weights[k];
+        }
+}
+
+// Adapters that let the Dijkstra functions below run on either graph type
+inline NodeType NodeCount(const GraphType &graph) { return (NodeType)graph.size(); }
+inline NodeType NodeCount(const CsrGraph &graph) { return graph.size(); }
+
+template <typename Visit>
+inline void ForEachEdge(const GraphType &graph, NodeType u, Visit visit)
+{
+    for (const auto &neighbor : graph[u])
+        visit(neighbor.first, neighbor.second);
+}
+
+template <typename Visit>
+inline void ForEachEdge(const CsrGraph &graph, NodeType u, Visit visit)
+{
+    const NodeType *targets = graph.targets.data();
+    const WeightType *weights = graph.weights.data();
+    for (NodeType k = graph.offsets[u], end = graph.offsets[u + 1]; k < end; k++)
+        visit(targets[k], weights[k]);
+}
+
+/*------------------------------------------------------------------------------
+ ShortestPathTree
+  The result of one single-source Dijkstra run: the shortest distance from the
+  source to every node and the predecessor of every node on its shortest path
+
+ Vairables:
+   - source: the source node
+   - distances: distances[v] is the length of the shortest path to v, UINT_MAX if v is unreachable
+   - previous: previous[v] is the node before v on that path, UINT_MAX for the source and unreachable nodes
+
+------------------------------------------------------------------------------*/
+struct ShortestPathTree
+{
+    NodeType source;
+    std::vector<WeightType> distances;
+    std::vector<NodeType> previous;
+};
+
+/*------------------------------------------------------------------------------
+ Priority queues for BuildShortestPathTree
+  Every queue holds (distance, node) entries ordered by distance and then by node,
+  so that all of them settle the nodes in the same order and build the same tree
+  (the radix heap only guarantees this for positive weights). The interface is:
+   - Reset(n): empty the queue for a graph of n nodes
+   - Push(v, dist): insert v or lower its distance; dist is never larger than before
+   - Pop(u, dist): take out the smallest entry, false if the queue is empty.
+     Entries that were superseded by a later Push may still come out; the caller
+     drops them because dist no longer matches the node's distance.
+   - Size(): the number of entries held
+------------------------------------------------------------------------------*/
+
+// Lazy binary heap: every Push adds an entry, so the heap can hold O(E) entries
+class BinaryHeapQueue
+{
+public:
+    void Reset(NodeType) { heap_.clear(); }
+    void Push(NodeType v, WeightType dist)
+    {
+        heap_.push_back(std::make_pair(dist, v));
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<std::pair<WeightType, NodeType>>());
+    }
+    bool Pop(NodeType &u, WeightType &dist)
+    {
+        if (heap_.empty())
+            return false;
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<std::pair<WeightType, NodeType>>());
+        dist = heap_.back().first;
+        u = heap_.back().second;
+        heap_.pop_back();
+        return true;
+    }
+    size_t Size() const { return heap_.size(); }
+
+private:
+    std::vector<std::pair<WeightType, NodeType>> heap_;
+};
+
+// Indexed d-ary heap with decrease-key: at most one entry per node, and a node's
+// position is tracked so that Push moves an existing entry up instead of adding one
+template <unsigned Arity = 4>
+class IndexedHeapQueue
+{
+public:
+    // only the nodes still in the heap have a position, so a reset costs what the last search left behind
+    void Reset(NodeType n)
+    {
+        for (NodeType v : heap_)
+            position_[v] = UINT_MAX;
+        heap_.clear();
+        if (position_.size() != n)
+        {
+            position_.assign(n, UINT_MAX);
+            key_.resize(n);
+        }
+    }
+    void Push(NodeType v, WeightType dist)
+    {
+        key_[v] = dist;
+        if (position_[v] == UINT_MAX)
+        {
+            heap_.push_back(v);
+            SiftUp((NodeType)heap_.size() - 1, v);
+        }
+        else
+            SiftUp(position_[v], v);
+    }
+    bool Pop(NodeType &u, WeightType &dist)
+    {
+        if (heap_.empty())
+            return false;
+        u = heap_[0];
+        dist = key_[u];
+        position_[u] = UINT_MAX;
+        NodeType last = heap_.back();
+        heap_.pop_back();
+        if (!heap_.empty())
+            SiftDown(0, last);
+        return true;
+    }
+    size_t Size() const { return heap_.size(); }
+
+private:
+    bool Before(NodeType a, NodeType b) const
+    {
+        return key_[a] < key_[b] || (key_[a] == key_[b] && a < b);
+    }
+    // moves the hole at i up until v fits and places v there
+    void SiftUp(NodeType i, NodeType v)
+    {
+        while (i > 0)
+        {
+            NodeType parent = (i - 1) / Arity;
+            if (!Before(v, heap_[parent]))
+                break;
+            heap_[i] = heap_[parent];
+            position_[heap_[i]] = i;
+            i = parent;
+        }
+        heap_[i] = v;
+        position_[v] = i;
+    }
+    // moves the hole at i down until v fits and places v there
+    void SiftDown(NodeType i, NodeType v)
+    {
+        const NodeType n = (NodeType)heap_.size();
+        while (true)
+        {
+            NodeType first = i * Arity + 1;
+            if (first >= n)
+                break;
+            NodeType best = first;
+            for (NodeType c = first + 1; c < first + Arity && c < n; c++)
+                if (Before(heap_[c], heap_[best]))
+                    best = c;
+            if (!Before(heap_[best], v))
+                break;
+            heap_[i] = heap_[best];
+            position_[heap_[i]] = i;
+            i = best;
+        }
+        heap_[i] = v;
+        position_[v] = i;
+    }
+
+    std::vector<NodeType> heap_;
+    std::vector<NodeType> position_; // UINT_MAX if the node is not in the heap
+    std::vector<WeightType> key_;
+};
+
+// Monotone radix heap: entries are 64-bit keys (distance << 32 | node), kept in
+// buckets by the highest bit in which they differ from the last key taken out.
+// Popping only scans the buckets and redistributes one of them, which works because
+// Dijkstra never pushes a key below the last one popped (with a zero-weight edge it
+// may, and such an entry goes to bucket 0 and comes out next).
+class RadixHeapQueue
+{
+public:
+    RadixHeapQueue() : last_(0), size_(0) {}
+    void Reset(NodeType)
+    {
+        for (auto &bucket : buckets_)
+            bucket.clear();
+        last_ = 0;
+        size_ = 0;
+    }
+    void Push(NodeType v, WeightType dist)
+    {
+        unsigned long long key = ((unsigned long long)dist << 32) | v;
+        buckets_[Bucket(key)].push_back(key);
+        size_++;
+    }
+    bool Pop(NodeType &u, WeightType &dist)
+    {
+        if (size_ == 0)
+            return false;
+        if (buckets_[0].empty())
+        {
+            int i = 1;
+            while (buckets_[i].empty())
+                i++;
+            last_ = *std::min_element(buckets_[i].begin(), buckets_[i].end());
+            for (auto key : buckets_[i])
+                buckets_[Bucket(key)].push_back(key);
+            buckets_[i].clear();
+        }
+        unsigned long long key = buckets_[0].back();
+        buckets_[0].pop_back();
+        size_--;
+        u = (NodeType)key;
+        dist = (WeightType)(key >> 32);
+        return true;
+    }
+    size_t Size() const { return size_; }
+
+private:
+    int Bucket(unsigned long long key) const
+    {
+        return key <= last_ ? 0 : 64 - __builtin_clzll(key ^ last_);
+    }
+
+    std::vector<unsigned long long> buckets_[65];
+    unsigned long long last_;
+    size_t size_;
+};
+
+/*------------------------------------------------------------------------------
+ BuildShortestPathTree
+  Run the Dijkstra's algorithm once from source and keep the whole shortest path tree
+
+ Vairables:
+   - Queue: the priority queue, BinaryHeapQueue by default, or IndexedHeapQueue<> or RadixHeapQueue
+   - graph: the input graph, a GraphType or a CsrGraph
+   - source: the source node
+   - tree: receives the distances and predecessors of all nodes
+   - target: if given, the search stops as soon as target is settled. The path
+     to target is then final, while the other nodes may keep larger distances.
+
+------------------------------------------------------------------------------*/
+template <typename Queue = BinaryHeapQueue, typename Graph>
+void BuildShortestPathTree(
+    const Graph &graph,
+    const NodeType &source,
+    ShortestPathTree &tree,
+    const NodeType &target = UINT_MAX)
+{
+    const NodeType n = NodeCount(graph);
+    tree.source = source;
+    tree.distances.assign(n, UINT_MAX);
+    tree.previous.assign(n, UINT_MAX);
+    std::vector<WeightType> &distances = tree.distances;
+    std::vector<NodeType> &previous = tree.previous;
+
+    distances[source] = 0;
+    Queue pq;
+    pq.Reset(n);
+    pq.Push(source, 0);
+
+    NodeType u;
+    WeightType dist;
+    while (pq.Pop(u, dist))
+    {
+        // an entry superseded by a shorter distance, or u was settled already
+        if (dist != distances[u])
+            continue;
+        if (u == target)
+            break;
+
+        ForEachEdge(graph, u, [&](NodeType v, WeightType weight)
+                    {
+                        if (dist + weight < distances[v])
+                        {
+                            distances[v] = dist + weight;
+                            previous[v] = u;
+                            pq.Push(v, distances[v]);
+                        } });
+    }
+}
+
+/*------------------------------------------------------------------------------
+ ExtractPath
+  Rebuild the shortest path from the tree's source to end in O(path length)
+
+ Vairables:
+   - tree: a tree built by BuildShortestPathTree
+   - end: the target node
+   - path_len: the the summation of weights of all edges in the shortest path
+   - path: the shortest path represented as a list of nodes; just end if it is unreachable
+
+------------------------------------------------------------------------------*/
+void ExtractPath(
+    const ShortestPathTree &tree,
+    const NodeType &end,
+    WeightType &path_len,
+    std::vector<NodeType> &path)
+{
+    path.clear();
+    path_len = tree.distances[end];
+    NodeType current = end;
+    while (current != UINT_MAX)
+    {
+        path.push_back(current);
+        current = tree.previous[current];
+    }
+    std::reverse(path.begin(), path.end());
+}
+
+// Appends the line the lab prints for a path to text: the nodes of the path, then its length
+void AppendPathANDLength(const WeightType &path_len, const std::vector<NodeType> &path, std::string &text)
+{
+    for (auto x : path)
+    {
+        text += std::to_string(x);
+        text += ' ';
+    }
+    text += std::to_string(path_len);
+    text += '\n';
+}
+
+/*------------------------------------------------------------------------------
+ DijkstraWorkspace
+  The state of point-to-point Dijkstra searches, kept and reused between queries.
+  The search records every node it reaches, and the next one resets only those
+  nodes instead of |V| entries; the queue is likewise reset with only the entries
+  the last search left in it. Local() gives every thread its own workspace, so
+  concurrent callers never share one.
+
+ Vairables:
+   - Queue: the priority queue, BinaryHeapQueue by default, or IndexedHeapQueue<> or RadixHeapQueue
+
+------------------------------------------------------------------------------*/
+template <typename Queue = BinaryHeapQueue>
+class DijkstraWorkspace
+{
+public:
+    // The workspace of the calling thread
+    static DijkstraWorkspace &Local()
+    {
+        static thread_local DijkstraWorkspace workspace;
+        return workspace;
+    }
+
+    // Same search and result as BuildShortestPathTree with target end followed by ExtractPath
+    template <typename Graph>
+    void ShortestPath(
+        const Graph &graph,
+        const NodeType &source,
+        const NodeType &end,
+        WeightType &path_len,
+        std::vector<NodeType> &path)
+    {
+        Start(NodeCount(graph));
+        Set(source, 0, UINT_MAX);
+        queue_.Push(source, 0);
+
+        NodeType u;
+        WeightType dist;
+        while (queue_.Pop(u, dist))
+        {
+            if (dist != distances_[u])
+                continue;
+            if (u == end)
+                break;
+
+            ForEachEdge(graph, u, [&](NodeType v, WeightType weight)
+                        {
+                            if (dist + weight < distances_[v])
+                            {
+                                Set(v, dist + weight, u);
+                                queue_.Push(v, dist + weight);
+                            } });
+        }
+
+        path.clear();
+        path_len = distances_[end];
+        for (NodeType current = end; current != UINT_MAX; current = previous_[current])
+            path.push_back(current);
+        std::reverse(path.begin(), path.end());
+    }
+
+    // The distance and predecessor of v found by the last search, UINT_MAX if it did not reach v
+    WeightType Distance(NodeType v) const { return distances_[v]; }
+    NodeType Previous(NodeType v) const { return previous_[v]; }
+
+private:
+    // Undoes the last search in O(nodes it reached), or sizes the arrays for a graph of n nodes
+    void Start(NodeType n)
+    {
+        if (distances_.size() != n)
+        {
+            distances_.assign(n, UINT_MAX);
+            previous_.assign(n, UINT_MAX);
+        }
+        else
+            for (NodeType v : touched_)
+            {
+                distances_[v] = UINT_MAX;
+                previous_[v] = UINT_MAX;
+            }
+        touched_.clear();
+        queue_.Reset(n);
+    }
+
+    void Set(NodeType v, WeightType distance, NodeType previous)
+    {
+        if (distances_[v] == UINT_MAX)
+            touched_.push_back(v);
+        distances_[v] = distance;
+        previous_[v] = previous;
+    }
+
+    std::vector<WeightType> distances_;
+    std::vector<NodeType> previous_;
+    std::vector<NodeType> touched_;
+    Queue queue_;
+};
+
 /*------------------------------------------------------------------------------
  ShortestPath_Dijkstra
   Find and print the shortest path from source to end using the Dijkstra's algorithm
@@ -34,51 +569,213 @@ void ShortestPath_Dijkstra(
     std::vector<NodeType> &path)
 {
     /*------ CODE BEGINS ------*/
-    std::vector<WeightType> distances(graph.size(), UINT_MAX);
-    std::vector<NodeType> previous(graph.size(), UINT_MAX);
-    std::vector<bool> visited(graph.size(), false);
+    // the calling thread's workspace, so repeated calls neither allocate nor clear |V| entries
+    DijkstraWorkspace<>::Local().ShortestPath(graph, source, end, path_len, path);
+    /*------ CODE ENDS ------*/
+}
 
-    distances[source] = 0;
-    std::priority_queue<std::pair<WeightType, NodeType>,
-                        std::vector<std::pair<WeightType, NodeType>>,
-                        std::greater<std::pair<WeightType, NodeType>>>
-        pq;
+// Same as above on a CsrGraph
+void ShortestPath_Dijkstra(
+    const CsrGraph &graph,
+    const NodeType &source,
+    const NodeType &end,
+    WeightType &path_len,
+    std::vector<NodeType> &path)
+{
+    DijkstraWorkspace<>::Local().ShortestPath(graph, source, end, path_len, path);
+}
 
-    pq.push(std::make_pair(0, source));
+/*------------------------------------------------------------------------------
+ ShortestPath_BidirectionalDijkstra
+  Find the shortest path from source to end with two Dijkstra searches, one
+  forward from source over graph and one backward from end over reverse, that
+  take turns settling a node. Once the smallest keys of the two queues add up to
+  at least the best source-end distance seen, no shorter path can exist and the
+  searches stop. On ties, the path may differ from the one of ShortestPath_Dijkstra,
+  but it has the same length.
 
-    while (!pq.empty())
-    {
-        NodeType u = pq.top().second;
-        pq.pop();
+ Vairables:
+   - Queue: the priority queue of both searches, as for BuildShortestPathTree
+   - graph: the input graph
+   - reverse: the graph built from it by BuildReverseGraph
+   - source, end, path_len, path: as for ShortestPath_Dijkstra
+   - settled: if not NULL, receives the number of nodes settled by both searches
 
-        if (visited[u])
-            continue;
-        visited[u] = true;
+------------------------------------------------------------------------------*/
+template <typename Queue = BinaryHeapQueue>
+void ShortestPath_BidirectionalDijkstra(
+    const CsrGraph &graph,
+    const CsrGraph &reverse,
+    const NodeType &source,
+    const NodeType &end,
+    WeightType &path_len,
+    std::vector<NodeType> &path,
+    size_t *settled = NULL)
+{
+    const NodeType n = graph.size();
+    // index 0: forward search from source, index 1: backward search from end
+    const CsrGraph *graphs[2] = {&graph, &reverse};
+    std::vector<WeightType> distances[2] = {std::vector<WeightType>(n, UINT_MAX), std::vector<WeightType>(n, UINT_MAX)};
+    std::vector<NodeType> previous[2] = {std::vector<NodeType>(n, UINT_MAX), std::vector<NodeType>(n, UINT_MAX)};
+    Queue pq[2];
+    WeightType key[2] = {0, 0}; // the last key taken out of each queue
+    unsigned long long best = source == end ? 0 : ULLONG_MAX;
+    NodeType meet = source;
+    size_t count = 0;
 
-        for (const auto &neighbor : graph[u])
-        {
-            NodeType v = neighbor.first;
-            WeightType weight = neighbor.second;
+    distances[0][source] = 0;
+    distances[1][end] = 0;
+    for (int side = 0; side < 2; side++)
+    {
+        pq[side].Reset(n);
+        pq[side].Push(side == 0 ? source : end, 0);
+    }
 
-            if (distances[u] != UINT_MAX && distances[u] + weight < distances[v])
-            {
-                distances[v] = distances[u] + weight;
-                previous[v] = u;
-                pq.push(std::make_pair(distances[v], v));
-            }
-        }
+    // an empty queue means that side reached everything it can, and the best meeting is known
+    for (int side = 0;; side = 1 - side)
+    {
+        NodeType u;
+        WeightType dist;
+        bool empty;
+        while (!(empty = !pq[side].Pop(u, dist)) && dist != distances[side][u])
+            ;
+        if (empty)
+            break;
+        key[side] = dist;
+        if ((unsigned long long)key[0] + key[1] >= best)
+            break;
+        count++;
+
+        std::vector<WeightType> &mine = distances[side], &other = distances[1 - side];
+        ForEachEdge(*graphs[side], u, [&](NodeType v, WeightType weight)
+                    {
+                        if (dist + weight < mine[v])
+                        {
+                            mine[v] = dist + weight;
+                            previous[side][v] = u;
+                            pq[side].Push(v, mine[v]);
+                        }
+                        if (other[v] != UINT_MAX && (unsigned long long)mine[v] + other[v] < best)
+                        {
+                            best = (unsigned long long)mine[v] + other[v];
+                            meet = v;
+                        } });
     }
+    if (settled)
+        *settled = count;
 
     path.clear();
-    path_len = distances[end];
-    NodeType current = end;
-    while (current != UINT_MAX)
+    if (best == ULLONG_MAX)
     {
-        path.push_back(current);
-        current = previous[current];
+        // unreachable: the same result as ShortestPath_Dijkstra
+        path_len = UINT_MAX;
+        path.push_back(end);
+        return;
     }
+    path_len = (WeightType)best;
+    for (NodeType v = meet; v != UINT_MAX; v = previous[0][v])
+        path.push_back(v);
     std::reverse(path.begin(), path.end());
-    /*------ CODE ENDS ------*/
+    for (NodeType v = previous[1][meet]; v != UINT_MAX; v = previous[1][v])
+        path.push_back(v);
+}
+
+// Runs job(i, thread) for i = 0 ... count - 1 on num_threads threads that take the indexes in turn
+template <typename Job>
+void ParallelFor(size_t count, unsigned num_threads, Job job)
+{
+    std::atomic<size_t> next(0);
+    auto worker = [&](unsigned thread)
+    {
+        for (size_t i = next++; i < count; i = next++)
+            job(i, thread);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads && t < count; t++)
+        threads.push_back(std::thread(worker, t));
+    worker(0);
+    for (auto &thread : threads)
+        thread.join();
+}
+
+/*------------------------------------------------------------------------------
+ ForEachSourceTree
+  Build the shortest path tree of every source on several threads and write the
+  text produced for each source to out, in the order of the sources
+
+ Vairables:
+   - nodes: the number of nodes, every one of which is a source
+   - num_threads: number of threads; 0 means one per hardware thread
+   - build: called as build(source, tree) to fill tree; must be safe to call from several threads
+   - format: called as format(tree, text) for every source; appends the output of that source to text
+   - out: the stream the texts are written to
+
+ The sources are handled in batches of APSP_SOURCES_PER_THREAD per thread. Inside
+ a batch, the threads take the next source from a shared counter. Each thread
+ reuses its own tree, and every source gets its own text buffer. The buffers are
+ written out in source order once the batch is done, so the output does not
+ depend on the thread count.
+------------------------------------------------------------------------------*/
+template <typename Build, typename Format>
+void ForEachSourceTree(
+    NodeType n,
+    unsigned num_threads,
+    Build build,
+    Format format,
+    std::ostream &out)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    const NodeType batch = std::max(1u, num_threads * APSP_SOURCES_PER_THREAD);
+    std::vector<std::string> texts(std::min(n, batch));
+
+    for (NodeType first = 0; first < n; first += batch)
+    {
+        const NodeType count = std::min(batch, n - first);
+        std::atomic<NodeType> next(0);
+        auto worker = [&]()
+        {
+            ShortestPathTree tree;
+            for (NodeType k = next++; k < count; k = next++)
+            {
+                build(first + k, tree);
+                texts[k].clear();
+                format(tree, texts[k]);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned t = 1; t < std::min<NodeType>(num_threads, count); t++)
+            threads.push_back(std::thread(worker));
+        worker();
+        for (auto &thread : threads)
+            thread.join();
+
+        for (NodeType k = 0; k < count; k++)
+            out.write(texts[k].data(), texts[k].size());
+    }
+}
+
+/*------------------------------------------------------------------------------
+ AllPairsShortestPaths
+  Run the Dijkstra's algorithm from every node on several threads and write the
+  text produced for each source to out, in the order of the sources
+
+ Vairables:
+   - graph: the input graph, a GraphType or a CsrGraph shared read-only by all threads
+   - num_threads, format, out: as for ForEachSourceTree
+
+------------------------------------------------------------------------------*/
+template <typename Graph, typename Format>
+void AllPairsShortestPaths(
+    const Graph &graph,
+    unsigned num_threads,
+    Format format,
+    std::ostream &out)
+{
+    ForEachSourceTree(NodeCount(graph), num_threads, [&graph](NodeType source, ShortestPathTree &tree)
+                      { BuildShortestPathTree(graph, source, tree); },
+                      format, out);
 }
 
 #endif
\ No newline at end of file
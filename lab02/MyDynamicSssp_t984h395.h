@@ -0,0 +1,296 @@
+#ifndef _MY_DYNAMIC_SSSP_H_
+#define _MY_DYNAMIC_SSSP_H_
+
+#include "MyDijkstra_t984h395.h"
+
+const WeightType DYNAMIC_EDGE_REMOVED = UINT_MAX; // the weight of an EdgeUpdate that deletes the edge
+
+// Sets the weight of the edge source -> target, inserting it if it is missing,
+// or deletes it if weight is DYNAMIC_EDGE_REMOVED
+struct EdgeUpdate
+{
+    NodeType source;
+    NodeType target;
+    WeightType weight;
+};
+
+/*------------------------------------------------------------------------------
+ DynamicShortestPathTree
+  The shortest path tree of one source, kept up to date while the edges of the
+  graph are inserted, deleted and re-weighted. The graph holds at most one edge
+  per (source, target) pair; parallel input edges are merged into the lightest.
+
+ Vairables:
+   - graph: the initial graph, a GraphType or a CsrGraph
+   - source: the source node
+
+ After every batch the tree equals the one BuildShortestPathTree builds on
+ Graph() from scratch: same distances, and for positive weights the same
+ predecessors, since v's predecessor is always the in-neighbor u with
+ distances[u] + weight == distances[v] that has the smallest (distances[u], u),
+ which is the one Dijkstra's algorithm keeps. Zero weights break that order, as
+ nodes at the same distance may pick each other and close a cycle, so while the
+ graph has a zero-weight edge every batch rebuilds the tree from scratch.
+------------------------------------------------------------------------------*/
+class DynamicShortestPathTree
+{
+public:
+    template <typename Graph>
+    DynamicShortestPathTree(const Graph &graph, const NodeType &source) : zero_arcs_(0)
+    {
+        const NodeType n = NodeCount(graph);
+        out_.resize(n);
+        in_.resize(n);
+        for (NodeType u = 0; u < n; u++)
+            ForEachEdge(graph, u, [&](NodeType v, WeightType weight)
+                        {
+                            WeightType old = Find(out_[u], v);
+                            if (weight < old)
+                                SetArc(u, v, weight); });
+        marked_.assign(n, 0);
+        BuildShortestPathTree(out_, source, tree_);
+    }
+
+    const ShortestPathTree &Tree() const { return tree_; }
+    const GraphType &Graph() const { return out_; }
+
+    /*--------------------------------------------------------------------------
+     Apply
+      Apply a batch of edge updates and repair the tree; returns the number of
+      nodes whose distance was recomputed. Later updates of the same edge in the
+      batch override earlier ones, and nodes beyond the current ones are added.
+
+      The repair follows Ramalingam and Reps, in two phases:
+       1. Increases and deletions. Only the subtrees below tree edges that got
+          heavier can lose their distances. Their nodes are reset, seeded from
+          their in-edges that come from outside the subtrees, and settled with a
+          Dijkstra search confined to the subtrees.
+       2. Decreases and insertions. Every such edge that now gives a shorter path
+          seeds a Dijkstra search that only follows strict improvements.
+      Finally the predecessors are chosen again, only for the nodes whose
+      distance or in-edges changed and the out-neighbors of those whose
+      distance changed. If the graph has zero-weight edges after the batch, the
+      tree is rebuilt by BuildShortestPathTree instead, and all nodes count.
+
+    --------------------------------------------------------------------------*/
+    size_t Apply(const std::vector<EdgeUpdate> &updates)
+    {
+        std::vector<EdgeUpdate> batch(updates);
+        // the last update of every edge wins
+        std::stable_sort(batch.begin(), batch.end(), [](const EdgeUpdate &a, const EdgeUpdate &b)
+                         { return a.source < b.source || (a.source == b.source && a.target < b.target); });
+        size_t kept = 0;
+        for (size_t k = 0; k < batch.size(); k++)
+        {
+            if (kept > 0 && batch[kept - 1].source == batch[k].source && batch[kept - 1].target == batch[k].target)
+                kept--;
+            batch[kept++] = batch[k];
+        }
+        batch.resize(kept);
+        for (const auto &update : batch)
+            Grow(std::max(update.source, update.target) + 1);
+
+        std::vector<WeightType> &distances = tree_.distances;
+        std::vector<NodeType> &previous = tree_.previous;
+        std::vector<EdgeUpdate> decreases;
+        std::vector<NodeType> affected;
+        for (const auto &update : batch)
+        {
+            const WeightType old = Find(out_[update.source], update.target);
+            if (update.weight == old || update.source == update.target)
+            {
+                if (update.weight != old)
+                    SetArc(update.source, update.target, update.weight); // a self loop is never on a shortest path
+                continue;
+            }
+            Mark(update.target); // its in-edges change, so its predecessor is chosen again
+            if (update.weight < old)
+            {
+                decreases.push_back(update);
+                continue;
+            }
+            SetArc(update.source, update.target, update.weight);
+            if (previous[update.target] == update.source && !IsAffected(update.target))
+                AddAffected(update.target, affected);
+        }
+
+        // phase 1: the subtrees below the heavier tree edges
+        for (size_t k = 0; k < affected.size(); k++)
+            for (const auto &arc : out_[affected[k]])
+                if (previous[arc.first] == affected[k] && !IsAffected(arc.first))
+                    AddAffected(arc.first, affected);
+        queue_.Reset(NodeCount(out_));
+        for (NodeType v : affected)
+        {
+            distances[v] = UINT_MAX;
+            Mark(v, CHANGED);
+            changed_.push_back(v);
+        }
+        for (NodeType v : affected)
+            for (const auto &arc : in_[v])
+                if (!IsAffected(arc.first))
+                    Lower(v, distances[arc.first], arc.second);
+        Settle(true);
+
+        // phase 2: the lighter and the new edges
+        for (const auto &update : decreases)
+        {
+            SetArc(update.source, update.target, update.weight);
+            Lower(update.target, distances[update.source], update.weight);
+        }
+        Settle(false);
+
+        // the predecessors of the marked nodes, then the marks are cleared
+        size_t repaired = changed_.size();
+        if (zero_arcs_ > 0)
+        {
+            BuildShortestPathTree(out_, tree_.source, tree_);
+            repaired = NodeCount(out_);
+            changed_.clear();
+        }
+        for (NodeType v : changed_)
+        {
+            Mark(v);
+            for (const auto &arc : out_[v])
+                Mark(arc.first);
+        }
+        for (NodeType v : touched_)
+        {
+            if (zero_arcs_ == 0)
+                previous[v] = ChoosePrevious(v);
+            marked_[v] = 0;
+        }
+        touched_.clear();
+        changed_.clear();
+        return repaired;
+    }
+
+private:
+    static const char MARKED = 1;   // the predecessor is chosen again at the end of the batch
+    static const char AFFECTED = 2; // in a subtree of phase 1
+    static const char CHANGED = 4;  // the distance was recomputed
+
+    // The weight of the edge to v in list, UINT_MAX if there is none
+    static WeightType Find(const std::vector<std::pair<NodeType, WeightType>> &list, NodeType v)
+    {
+        for (const auto &arc : list)
+            if (arc.first == v)
+                return arc.second;
+        return UINT_MAX;
+    }
+
+    // Sets v's entry in list to weight, adding or removing it as needed
+    static void SetInList(std::vector<std::pair<NodeType, WeightType>> &list, NodeType v, WeightType weight)
+    {
+        for (size_t k = 0; k < list.size(); k++)
+            if (list[k].first == v)
+            {
+                if (weight == DYNAMIC_EDGE_REMOVED)
+                {
+                    list[k] = list.back();
+                    list.pop_back();
+                }
+                else
+                    list[k].second = weight;
+                return;
+            }
+        if (weight != DYNAMIC_EDGE_REMOVED)
+            list.push_back(std::make_pair(v, weight));
+    }
+
+    void SetArc(NodeType u, NodeType v, WeightType weight)
+    {
+        const WeightType old = Find(out_[u], v);
+        if (old == 0)
+            zero_arcs_--;
+        if (weight == 0)
+            zero_arcs_++;
+        SetInList(out_[u], v, weight);
+        SetInList(in_[v], u, weight);
+    }
+
+    void Grow(NodeType n)
+    {
+        if (n <= NodeCount(out_))
+            return;
+        out_.resize(n);
+        in_.resize(n);
+        marked_.resize(n, 0);
+        tree_.distances.resize(n, UINT_MAX);
+        tree_.previous.resize(n, UINT_MAX);
+    }
+
+    void Mark(NodeType v, char flag = MARKED)
+    {
+        if (marked_[v] == 0)
+            touched_.push_back(v);
+        marked_[v] |= flag;
+    }
+
+    bool IsAffected(NodeType v) const { return (marked_[v] & AFFECTED) != 0; }
+
+    void AddAffected(NodeType v, std::vector<NodeType> &affected)
+    {
+        Mark(v, AFFECTED);
+        affected.push_back(v);
+    }
+
+    // Lowers v's distance to dist + weight if that is shorter, and queues v
+    void Lower(NodeType v, WeightType dist, WeightType weight)
+    {
+        const unsigned long long next = (unsigned long long)dist + weight;
+        if (dist == UINT_MAX || next >= tree_.distances[v])
+            return;
+        tree_.distances[v] = (WeightType)next;
+        queue_.Push(v, (WeightType)next);
+        if (!(marked_[v] & CHANGED))
+        {
+            Mark(v, CHANGED);
+            changed_.push_back(v);
+        }
+    }
+
+    // Dijkstra from the queued nodes; in phase 1 it stays inside the affected subtrees
+    void Settle(bool confined)
+    {
+        NodeType u;
+        WeightType dist;
+        while (queue_.Pop(u, dist))
+        {
+            if (dist != tree_.distances[u])
+                continue;
+            for (const auto &arc : out_[u])
+                if (!confined || IsAffected(arc.first))
+                    Lower(arc.first, dist, arc.second);
+        }
+    }
+
+    // The in-neighbor u of v with distances[u] + weight == distances[v] and the smallest (distances[u], u)
+    NodeType ChoosePrevious(NodeType v) const
+    {
+        const std::vector<WeightType> &distances = tree_.distances;
+        if (v == tree_.source || distances[v] == UINT_MAX)
+            return UINT_MAX;
+        NodeType best = UINT_MAX;
+        for (const auto &arc : in_[v])
+        {
+            const NodeType u = arc.first;
+            if (distances[u] == UINT_MAX || (unsigned long long)distances[u] + arc.second != distances[v])
+                continue;
+            if (best == UINT_MAX || distances[u] < distances[best] || (distances[u] == distances[best] && u < best))
+                best = u;
+        }
+        return best;
+    }
+
+    GraphType out_;
+    GraphType in_; // in_[v]: the edges u -> v, as (u, weight)
+    ShortestPathTree tree_;
+    std::vector<char> marked_;      // MARKED, AFFECTED and CHANGED flags of the nodes the batch touched
+    std::vector<NodeType> touched_; // the nodes with flags set
+    std::vector<NodeType> changed_;
+    BinaryHeapQueue queue_;
+    size_t zero_arcs_; // the edges of weight 0
+};
+
+#endif
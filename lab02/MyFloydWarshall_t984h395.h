@@ -0,0 +1,252 @@
+#ifndef _MY_FLOYD_WARSHALL_H_
+#define _MY_FLOYD_WARSHALL_H_
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FLOYD_WARSHALL_X86 1
+#endif
+
+#include "MyDijkstra_t984h395.h"
+
+const NodeType FLOYD_WARSHALL_BLOCK = 64;       // tile edge: three 64 x 64 tiles of distances take 48 KB of L1/L2
+const NodeType FLOYD_WARSHALL_MAX_NODES = 2048; // larger graphs never get the V x V matrix (16 MB at this size)
+const unsigned FLOYD_WARSHALL_DEGREE_DIVISOR = 32; // the matrix wins from an average out-degree of nodes / 32 on
+
+/*------------------------------------------------------------------------------
+ DistanceMatrix
+  All-pairs distances, row i holding the distances from node i. Rows are padded
+  to whole tiles; padding entries are UINT_MAX.
+
+ Vairables:
+   - nodes: the number of nodes
+   - stride: the padded row length, a multiple of FLOYD_WARSHALL_BLOCK
+   - distances: stride * stride entries, UINT_MAX for unreachable pairs
+
+------------------------------------------------------------------------------*/
+struct DistanceMatrix
+{
+    NodeType nodes;
+    NodeType stride;
+    std::vector<WeightType> distances;
+
+    WeightType *Row(NodeType i) { return distances.data() + (size_t)i * stride; }
+    const WeightType *Row(NodeType i) const { return distances.data() + (size_t)i * stride; }
+};
+
+// The min-plus update of one row of a tile: c[j] = min(c[j], a + b[j]) for j < FLOYD_WARSHALL_BLOCK.
+// a + b[j] saturates at UINT_MAX, computed as a + min(b[j], UINT_MAX - a), so that the sentinel and
+// sums beyond it never win; a itself is below UINT_MAX.
+inline void MinPlusRow(WeightType *c, WeightType a, const WeightType *b)
+{
+    const WeightType limit = UINT_MAX - a;
+#ifdef FLOYD_WARSHALL_X86
+    // SSE2 has no unsigned 32-bit minimum, so the comparisons are signed ones on values with the sign bit flipped
+    const __m128i sign = _mm_set1_epi32((int)0x80000000u);
+    const __m128i va = _mm_set1_epi32((int)a), vlimit = _mm_set1_epi32((int)(limit ^ 0x80000000u));
+    for (NodeType j = 0; j < FLOYD_WARSHALL_BLOCK; j += 4)
+    {
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+        __m128i over = _mm_cmpgt_epi32(_mm_xor_si128(vb, sign), vlimit);
+        __m128i sum = _mm_add_epi32(va, _mm_or_si128(_mm_and_si128(over, _mm_xor_si128(vlimit, sign)),
+                                                      _mm_andnot_si128(over, vb)));
+        __m128i vc = _mm_loadu_si128((const __m128i *)(c + j));
+        __m128i less = _mm_cmpgt_epi32(_mm_xor_si128(vc, sign), _mm_xor_si128(sum, sign));
+        _mm_storeu_si128((__m128i *)(c + j), _mm_or_si128(_mm_and_si128(less, sum), _mm_andnot_si128(less, vc)));
+    }
+#else
+    for (NodeType j = 0; j < FLOYD_WARSHALL_BLOCK; j++)
+        c[j] = std::min(c[j], a + std::min(b[j], limit));
+#endif
+}
+
+// Updates tile c with the tiles a (rows of c, columns k) and b (rows k, columns of c) for every k of the tile
+inline void MinPlusTile(WeightType *c, const WeightType *a, const WeightType *b, NodeType stride)
+{
+    for (NodeType k = 0; k < FLOYD_WARSHALL_BLOCK; k++)
+        for (NodeType i = 0; i < FLOYD_WARSHALL_BLOCK; i++)
+        {
+            const WeightType aik = a[(size_t)i * stride + k];
+            if (aik != UINT_MAX)
+                MinPlusRow(c + (size_t)i * stride, aik, b + (size_t)k * stride);
+        }
+}
+
+#ifdef FLOYD_WARSHALL_X86
+// The same tile update with AVX2, whose unsigned minimum handles the saturation directly
+__attribute__((target("avx2"))) inline void MinPlusTileAvx2(WeightType *c, const WeightType *a, const WeightType *b,
+                                                              NodeType stride)
+{
+    for (NodeType k = 0; k < FLOYD_WARSHALL_BLOCK; k++)
+        for (NodeType i = 0; i < FLOYD_WARSHALL_BLOCK; i++)
+        {
+            const WeightType aik = a[(size_t)i * stride + k];
+            if (aik == UINT_MAX)
+                continue;
+            const __m256i va = _mm256_set1_epi32((int)aik), vlimit = _mm256_set1_epi32((int)(UINT_MAX - aik));
+            WeightType *ci = c + (size_t)i * stride;
+            const WeightType *bk = b + (size_t)k * stride;
+            for (NodeType j = 0; j < FLOYD_WARSHALL_BLOCK; j += 8)
+            {
+                __m256i sum = _mm256_add_epi32(va, _mm256_min_epu32(_mm256_loadu_si256((const __m256i *)(bk + j)), vlimit));
+                __m256i *cj = (__m256i *)(ci + j);
+                _mm256_storeu_si256(cj, _mm256_min_epu32(_mm256_loadu_si256(cj), sum));
+            }
+        }
+}
+#endif
+
+/*------------------------------------------------------------------------------
+ FloydWarshall
+  Compute all-pairs distances with a cache-blocked Floyd-Warshall algorithm
+
+ Vairables:
+   - graph: the input graph, a GraphType or a CsrGraph
+   - matrix: receives the distances
+   - num_threads: number of threads; 0 means one per hardware thread
+
+ For every block k of FLOYD_WARSHALL_BLOCK nodes, the diagonal tile (k, k) is
+ closed first, then the tiles of row k and column k from it, then all other
+ tiles from their row-k and column-k tiles. The tiles of the last two steps are
+ independent and spread over the threads. The tile update uses AVX2 when the CPU
+ has it and SSE2 otherwise on x86, or plain code elsewhere.
+------------------------------------------------------------------------------*/
+template <typename Graph>
+void FloydWarshall(const Graph &graph, DistanceMatrix &matrix, unsigned num_threads = 0)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    const NodeType n = NodeCount(graph);
+    const NodeType blocks = (n + FLOYD_WARSHALL_BLOCK - 1) / FLOYD_WARSHALL_BLOCK;
+    const NodeType stride = blocks * FLOYD_WARSHALL_BLOCK;
+    matrix.nodes = n;
+    matrix.stride = stride;
+    matrix.distances.assign((size_t)stride * stride, UINT_MAX);
+    for (NodeType u = 0; u < n; u++)
+    {
+        WeightType *row = matrix.Row(u);
+        ForEachEdge(graph, u, [&](NodeType v, WeightType weight)
+                    { row[v] = std::min(row[v], weight); });
+        row[u] = 0;
+    }
+
+    void (*update)(WeightType *, const WeightType *, const WeightType *, NodeType) = MinPlusTile;
+#ifdef FLOYD_WARSHALL_X86
+    if (__builtin_cpu_supports("avx2"))
+        update = MinPlusTileAvx2;
+#endif
+    auto tile = [&](NodeType bi, NodeType bj)
+    {
+        return matrix.distances.data() + (size_t)bi * FLOYD_WARSHALL_BLOCK * stride + (size_t)bj * FLOYD_WARSHALL_BLOCK;
+    };
+    for (NodeType bk = 0; bk < blocks; bk++)
+    {
+        WeightType *diagonal = tile(bk, bk);
+        update(diagonal, diagonal, diagonal, stride);
+        // the tiles of row bk and of column bk, other than the diagonal
+        ParallelFor(2 * (blocks - 1), num_threads, [&](size_t k, unsigned)
+                    {
+                        NodeType other = (NodeType)(k / 2);
+                        other += other >= bk;
+                        if (k % 2 == 0)
+                            update(tile(bk, other), diagonal, tile(bk, other), stride);
+                        else
+                            update(tile(other, bk), tile(other, bk), diagonal, stride); });
+        // every other tile
+        ParallelFor((size_t)(blocks - 1) * (blocks - 1), num_threads, [&](size_t k, unsigned)
+                    {
+                        NodeType bi = (NodeType)(k / (blocks - 1)), bj = (NodeType)(k % (blocks - 1));
+                        bi += bi >= bk;
+                        bj += bj >= bk;
+                        update(tile(bi, bj), tile(bi, bk), tile(bk, bj), stride); });
+    }
+}
+
+/*------------------------------------------------------------------------------
+ BuildMatrixTree
+  Fill the shortest path tree of source from its row of the distance matrix.
+  v's predecessor is the in-neighbor u with distances[u] + weight == distances[v]
+  that has the smallest (distances[u], u), the one Dijkstra's algorithm keeps
+  as it settles the nodes in that order, so for positive weights the tree is the
+  same as the one of BuildShortestPathTree. One pass over the out-edges finds them.
+  Zero weights break that order: nodes at the same distance may pick each other
+  and close a cycle, so PreferFloydWarshall turns such graphs down.
+
+ Vairables:
+   - graph: the graph the matrix was computed for
+   - matrix: the distances from FloydWarshall
+   - source: the source node
+   - tree: receives the distances and predecessors of all nodes
+
+------------------------------------------------------------------------------*/
+template <typename Graph>
+void BuildMatrixTree(const Graph &graph, const DistanceMatrix &matrix, NodeType source, ShortestPathTree &tree)
+{
+    const NodeType n = matrix.nodes;
+    const WeightType *distances = matrix.Row(source);
+    tree.source = source;
+    tree.distances.assign(distances, distances + n);
+    tree.previous.assign(n, UINT_MAX);
+    std::vector<NodeType> &previous = tree.previous;
+    // u grows, so among equal distances the first u found keeps its place
+    for (NodeType u = 0; u < n; u++)
+    {
+        const WeightType dist = distances[u];
+        if (dist == UINT_MAX)
+            continue;
+        ForEachEdge(graph, u, [&](NodeType v, WeightType weight)
+                    {
+                        if (v != source && (unsigned long long)dist + weight == distances[v] &&
+                            (previous[v] == UINT_MAX || dist < distances[previous[v]]))
+                            previous[v] = u; });
+    }
+}
+
+// True if the blocked Floyd-Warshall engine is expected to beat one Dijkstra run per source. The matrix
+// takes V^3 / width vector steps and the Dijkstra runs about V * E heap steps, so it has to be small enough
+// to hold, and the average out-degree must be a fair fraction of V; FLOYD_WARSHALL_DEGREE_DIVISOR was measured
+// with the SSE2 update and is conservative with AVX2 (about V / 120 there). A graph with zero-weight edges
+// (zero_weights set) never is, as BuildMatrixTree cannot tell its predecessors apart.
+inline bool PreferFloydWarshall(NodeType nodes, size_t edges, bool zero_weights)
+{
+    return !zero_weights && nodes <= FLOYD_WARSHALL_MAX_NODES &&
+           edges * FLOYD_WARSHALL_DEGREE_DIVISOR >= (size_t)nodes * nodes;
+}
+
+/*------------------------------------------------------------------------------
+ AllPairsShortestPaths_Auto
+  The same output as AllPairsShortestPaths, computed with FloydWarshall and
+  BuildMatrixTree when PreferFloydWarshall says so, else with one Dijkstra run
+  per source
+
+ Vairables:
+   - graph, num_threads, format, out: as for AllPairsShortestPaths
+
+------------------------------------------------------------------------------*/
+template <typename Graph, typename Format>
+void AllPairsShortestPaths_Auto(
+    const Graph &graph,
+    unsigned num_threads,
+    Format format,
+    std::ostream &out)
+{
+    const NodeType n = NodeCount(graph);
+    size_t edges = 0;
+    bool zero_weights = false;
+    for (NodeType u = 0; u < n; u++)
+        ForEachEdge(graph, u, [&](NodeType, WeightType weight)
+                    {
+                        edges++;
+                        zero_weights = zero_weights || weight == 0; });
+    if (!PreferFloydWarshall(n, edges, zero_weights))
+    {
+        AllPairsShortestPaths(graph, num_threads, format, out);
+        return;
+    }
+    DistanceMatrix matrix;
+    FloydWarshall(graph, matrix, num_threads);
+    ForEachSourceTree(n, num_threads, [&](NodeType source, ShortestPathTree &tree)
+                      { BuildMatrixTree(graph, matrix, source, tree); },
+                      format, out);
+}
+
+#endif
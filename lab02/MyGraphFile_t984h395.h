@@ -0,0 +1,294 @@
+#ifndef _MY_GRAPH_FILE_H_
+#define _MY_GRAPH_FILE_H_
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MyDijkstra_t984h395.h"
+
+const size_t PARALLEL_PARSE_MIN_SIZE = 1 << 20; // text files below this size are parsed on the calling thread only
+const char CSR_FILE_MAGIC[4] = {'C', 'S', 'R', 'G'};
+const uint32_t CSR_FILE_VERSION = 1;
+
+/*------------------------------------------------------------------------------
+ CsrFileHeader
+  The start of a binary CSR graph file. It is followed by the arrays of a
+  CsrGraph, in the byte order of the machine that wrote it:
+  offsets (nodes + 1 values), targets (edges values), weights (edges values)
+
+ Vairables:
+   - magic: CSR_FILE_MAGIC
+   - version: CSR_FILE_VERSION when the file was written
+   - nodes, edges: the sizes of the arrays
+
+------------------------------------------------------------------------------*/
+struct CsrFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t nodes;
+    uint32_t reserved;
+    uint64_t edges;
+};
+
+/*------------------------------------------------------------------------------
+ CsrGraphView
+  A CsrGraph whose arrays are owned elsewhere, e.g. by a MappedCsrGraph. The
+  NodeCount and ForEachEdge adapters below let the templated search functions of
+  MyDijkstra_t984h395.h run on it.
+
+------------------------------------------------------------------------------*/
+struct CsrGraphView
+{
+    NodeType nodes;
+    const NodeType *offsets;
+    const NodeType *targets;
+    const WeightType *weights;
+
+    NodeType size() const { return nodes; }
+};
+
+inline NodeType NodeCount(const CsrGraphView &graph) { return graph.nodes; }
+
+template <typename Visit>
+inline void ForEachEdge(const CsrGraphView &graph, NodeType u, Visit visit)
+{
+    for (NodeType k = graph.offsets[u], end = graph.offsets[u + 1]; k < end; k++)
+        visit(graph.targets[k], graph.weights[k]);
+}
+
+// Writes graph to fname as a binary CSR graph file; returns false if the file cannot be written
+inline bool SaveCsrGraph(const CsrGraph &graph, const char *fname)
+{
+    FILE *file = std::fopen(fname, "wb");
+    if (!file)
+        return false;
+    CsrFileHeader header;
+    std::memcpy(header.magic, CSR_FILE_MAGIC, sizeof(header.magic));
+    header.version = CSR_FILE_VERSION;
+    header.nodes = graph.size();
+    header.reserved = 0;
+    header.edges = graph.targets.size();
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(graph.offsets.data(), sizeof(NodeType), graph.offsets.size(), file) == graph.offsets.size() &&
+              std::fwrite(graph.targets.data(), sizeof(NodeType), graph.targets.size(), file) == graph.targets.size() &&
+              std::fwrite(graph.weights.data(), sizeof(WeightType), graph.weights.size(), file) == graph.weights.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+// True if fname starts with the magic of a binary CSR graph file
+inline bool IsCsrGraphFile(const char *fname)
+{
+    char magic[sizeof(CSR_FILE_MAGIC)];
+    FILE *file = std::fopen(fname, "rb");
+    if (!file)
+        return false;
+    bool ok = std::fread(magic, sizeof(magic), 1, file) == 1 && std::memcmp(magic, CSR_FILE_MAGIC, sizeof(magic)) == 0;
+    std::fclose(file);
+    return ok;
+}
+
+/*------------------------------------------------------------------------------
+ MappedCsrGraph
+  A binary CSR graph file mapped read-only into memory. Graph() points straight
+  into the mapping, so opening the file copies nothing and the pages are read
+  on first use. The mapping lives as long as the object.
+
+------------------------------------------------------------------------------*/
+class MappedCsrGraph
+{
+public:
+    MappedCsrGraph() : mapping_(NULL), size_(0) { view_ = CsrGraphView{0, NULL, NULL, NULL}; }
+    ~MappedCsrGraph() { Close(); }
+
+    /*--------------------------------------------------------------------------
+     Open
+      Map fname and check its header, its size, its offsets array and that every
+      target is a node of the graph, in one pass over the offsets and one over the
+      targets. The weights are taken as they are. Returns false, with nothing mapped,
+      if the file is not a valid CSR graph file of this version.
+
+    --------------------------------------------------------------------------*/
+    bool Open(const char *fname)
+    {
+        Close();
+        int fd = open(fname, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || (size_t)info.st_size < sizeof(CsrFileHeader))
+        {
+            close(fd);
+            return false;
+        }
+        size_ = (size_t)info.st_size;
+        mapping_ = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping_ == MAP_FAILED)
+        {
+            mapping_ = NULL;
+            return false;
+        }
+
+        const CsrFileHeader *header = (const CsrFileHeader *)mapping_;
+        const uint64_t nodes = header->nodes, edges = header->edges;
+        if (std::memcmp(header->magic, CSR_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != CSR_FILE_VERSION || nodes >= UINT_MAX || edges > UINT_MAX ||
+            size_ != sizeof(CsrFileHeader) + (nodes + 1 + 2 * edges) * sizeof(NodeType))
+        {
+            Close();
+            return false;
+        }
+        const NodeType *offsets = (const NodeType *)(header + 1);
+        view_ = CsrGraphView{(NodeType)nodes, offsets, offsets + nodes + 1, offsets + nodes + 1 + edges};
+        bool ok = offsets[0] == 0 && offsets[nodes] == edges;
+        for (NodeType u = 0; ok && u < nodes; u++)
+            ok = offsets[u] <= offsets[u + 1];
+        for (NodeType k = 0; ok && k < edges; k++)
+            ok = view_.targets[k] < nodes;
+        if (!ok)
+            Close();
+        return ok;
+    }
+
+    void Close()
+    {
+        if (mapping_)
+            munmap(mapping_, size_);
+        mapping_ = NULL;
+        size_ = 0;
+        view_ = CsrGraphView{0, NULL, NULL, NULL};
+    }
+
+    const CsrGraphView &Graph() const { return view_; }
+
+private:
+    MappedCsrGraph(const MappedCsrGraph &);
+    MappedCsrGraph &operator=(const MappedCsrGraph &);
+
+    void *mapping_;
+    size_t size_;
+    CsrGraphView view_;
+};
+
+// Parses the unsigned integers of text[begin, end) into tokens. Tokens are separated by white space;
+// parsing stops at any other character, as reading with ifstream >> would, and then returns false.
+inline bool ParseEdgeTokens(const char *text, size_t begin, size_t end, std::vector<NodeType> &tokens)
+{
+    const char *p = text + begin, *stop = text + end;
+    while (p < stop)
+    {
+        if (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f')
+        {
+            p++;
+            continue;
+        }
+        if ((unsigned)(*p - '0') >= 10)
+            return false;
+        NodeType value = 0;
+        while (p < stop && (unsigned)(*p - '0') < 10)
+            value = value * 10 + (NodeType)(*p++ - '0');
+        tokens.push_back(value);
+    }
+    return true;
+}
+
+/*------------------------------------------------------------------------------
+ LoadEdgeList
+  Read a text edge list of "source target weight" triples, the format of the
+  test instances, into edges. The file is mapped into memory and cut at white
+  space into one chunk per thread; the chunks are parsed in parallel and the
+  triples are then assembled in file order. Gives the same edges as reading the
+  triples with ifstream >> until it fails.
+
+ Vairables:
+   - fname: the text file
+   - edges: receives the edges
+   - num_threads: number of threads; 0 means one per hardware thread. Files smaller
+     than PARALLEL_PARSE_MIN_SIZE are parsed on one thread.
+
+ Returns false if the file cannot be read.
+------------------------------------------------------------------------------*/
+inline bool LoadEdgeList(const char *fname, EdgeListType &edges, unsigned num_threads = 0)
+{
+    edges.clear();
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        close(fd);
+        return false;
+    }
+    const size_t size = (size_t)info.st_size;
+    if (size == 0)
+    {
+        close(fd);
+        return true;
+    }
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    const char *text = (const char *)mapping;
+
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (size < PARALLEL_PARSE_MIN_SIZE)
+        num_threads = 1;
+    // chunk t is text[bounds[t], bounds[t + 1]); every bound but the ends is just past a white space character
+    std::vector<size_t> bounds(num_threads + 1, size);
+    bounds[0] = 0;
+    for (unsigned t = 1; t < num_threads; t++)
+    {
+        size_t at = std::max(bounds[t - 1], size / num_threads * t);
+        while (at < size && !std::isspace((unsigned char)text[at]))
+            at++;
+        bounds[t] = std::min(size, at + 1);
+    }
+
+    std::vector<std::vector<NodeType>> tokens(num_threads);
+    std::vector<char> complete(num_threads, 1);
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads; t++)
+        threads.push_back(std::thread([&, t]()
+                                      { complete[t] = ParseEdgeTokens(text, bounds[t], bounds[t + 1], tokens[t]); }));
+    complete[0] = ParseEdgeTokens(text, bounds[0], bounds[1], tokens[0]);
+    for (auto &thread : threads)
+        thread.join();
+    munmap(mapping, size);
+
+    // the tokens up to the first chunk that stopped early, three per edge
+    size_t count = 0;
+    for (unsigned t = 0; t < num_threads; t++)
+    {
+        count += tokens[t].size();
+        if (!complete[t])
+        {
+            tokens.resize(t + 1);
+            break;
+        }
+    }
+    edges.resize(count / 3);
+    size_t k = 0;
+    NodeType triple[3];
+    for (const auto &chunk : tokens)
+        for (NodeType token : chunk)
+        {
+            triple[k % 3] = token;
+            if (++k % 3 == 0)
+                edges[k / 3 - 1] = EdgeType{triple[0], triple[1], (WeightType)triple[2]};
+        }
+    return true;
+}
+
+#endif
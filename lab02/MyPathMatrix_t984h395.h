@@ -0,0 +1,90 @@
+#ifndef _MY_PATH_MATRIX_H_
+#define _MY_PATH_MATRIX_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include "MyDijkstra_t984h395.h"
+
+const char PATH_MATRIX_MAGIC[4] = {'A', 'P', 'S', 'P'};
+const uint32_t PATH_MATRIX_VERSION = 1;
+
+/*------------------------------------------------------------------------------
+ PathMatrixHeader
+  The start of a binary all-pairs result. It is followed by one row per source,
+  in source order: the nodes distances of the source's tree, then its nodes
+  predecessors, all 4-byte values in the byte order of the machine that wrote
+  them. That is 8 * nodes * nodes bytes in total, and any path can be rebuilt
+  by following the predecessors of its source's row back from the target.
+
+ Vairables:
+   - magic: PATH_MATRIX_MAGIC
+   - version: PATH_MATRIX_VERSION when the file was written
+   - nodes: the number of nodes, and of rows
+
+------------------------------------------------------------------------------*/
+struct PathMatrixHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t nodes;
+    uint32_t reserved;
+};
+
+// Appends the header of a result for a graph of nodes nodes to out
+inline void AppendPathMatrixHeader(NodeType nodes, std::string &out)
+{
+    PathMatrixHeader header;
+    std::memcpy(header.magic, PATH_MATRIX_MAGIC, sizeof(header.magic));
+    header.version = PATH_MATRIX_VERSION;
+    header.nodes = nodes;
+    header.reserved = 0;
+    out.append((const char *)&header, sizeof(header));
+}
+
+// Appends the row of tree's source to out
+inline void AppendPathMatrixRow(const ShortestPathTree &tree, std::string &out)
+{
+    out.append((const char *)tree.distances.data(), tree.distances.size() * sizeof(WeightType));
+    out.append((const char *)tree.previous.data(), tree.previous.size() * sizeof(NodeType));
+}
+
+// Reads the header of a result from in; returns false if in does not hold one of this version
+inline bool ReadPathMatrixHeader(std::istream &in, NodeType &nodes)
+{
+    PathMatrixHeader header;
+    if (!in.read((char *)&header, sizeof(header)) ||
+        std::memcmp(header.magic, PATH_MATRIX_MAGIC, sizeof(header.magic)) != 0 || header.version != PATH_MATRIX_VERSION)
+        return false;
+    nodes = header.nodes;
+    return true;
+}
+
+// Reads the next row from in into tree, whose paths ExtractPath then rebuilds; returns false if the row is cut short
+inline bool ReadPathMatrixRow(std::istream &in, NodeType source, NodeType nodes, ShortestPathTree &tree)
+{
+    tree.source = source;
+    tree.distances.resize(nodes);
+    tree.previous.resize(nodes);
+    return in.read((char *)tree.distances.data(), nodes * sizeof(WeightType)) &&
+           in.read((char *)tree.previous.data(), nodes * sizeof(NodeType));
+}
+
+// Rebuilds the path to end from a row read by ReadPathMatrixRow, like ExtractPath. The row comes from a file, so
+// returns false if its predecessors leave the graph or take more than nodes steps without reaching the source
+inline bool ExtractMatrixPath(const ShortestPathTree &tree, NodeType end, WeightType &path_len, std::vector<NodeType> &path)
+{
+    const NodeType nodes = (NodeType)tree.previous.size();
+    path.clear();
+    path_len = tree.distances[end];
+    for (NodeType current = end; current != UINT_MAX; current = tree.previous[current])
+    {
+        if (current >= nodes || path.size() == nodes)
+            return false;
+        path.push_back(current);
+    }
+    std::reverse(path.begin(), path.end());
+    return true;
+}
+
+#endif
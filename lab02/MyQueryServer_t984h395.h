@@ -0,0 +1,490 @@
+#ifndef _MY_QUERY_SERVER_H_
+#define _MY_QUERY_SERVER_H_
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "MyDijkstra_t984h395.h"
+
+const size_t QUERY_CACHE_BYTES = 256 << 20;   // memory for cached trees when no tree count is given
+const size_t QUERY_LATENCY_WINDOW = 1 << 16;  // latest queries the percentiles are taken over
+const size_t QUERY_READ_SIZE = 64 << 10;      // bytes read from a client at a time
+const size_t QUERY_MAX_LINE = QUERY_READ_SIZE; // longest request line; a client sending a longer one is dropped
+const int QUERY_SEND_TIMEOUT = 10;             // seconds a socket client may leave its replies unread before it is dropped
+
+/*------------------------------------------------------------------------------
+ TreeCache
+  A least recently used cache of shortest path trees, by source. Trees are shared
+  read-only, so a tree evicted while a caller still reads it stays alive until
+  that caller is done. Safe to use from several threads.
+
+ Vairables:
+   - capacity: the number of trees kept, at least 1
+
+------------------------------------------------------------------------------*/
+class TreeCache
+{
+public:
+    typedef std::shared_ptr<const ShortestPathTree> TreePtr;
+
+    explicit TreeCache(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {}
+
+    // The tree of source, now the most recently used, or NULL if it is not cached
+    TreePtr Find(NodeType source)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = index_.find(source);
+        if (found == index_.end())
+            return TreePtr();
+        order_.splice(order_.begin(), order_, found->second);
+        return *found->second;
+    }
+
+    // Caches tree, evicting the least recently used tree if the cache is full; returns the cached tree
+    // of its source, which is an earlier one if another caller inserted it first
+    TreePtr Insert(const TreePtr &tree)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = index_.find(tree->source);
+        if (found != index_.end())
+        {
+            order_.splice(order_.begin(), order_, found->second);
+            return *found->second;
+        }
+        order_.push_front(tree);
+        index_[tree->source] = order_.begin();
+        if (order_.size() > capacity_)
+        {
+            index_.erase(order_.back()->source);
+            order_.pop_back();
+        }
+        return tree;
+    }
+
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return order_.size();
+    }
+    size_t Capacity() const { return capacity_; }
+
+private:
+    size_t capacity_;
+    std::mutex mutex_;
+    std::list<TreePtr> order_; // most recently used first
+    std::unordered_map<NodeType, std::list<TreePtr>::iterator> index_;
+};
+
+// Query counts and the latencies of the latest QUERY_LATENCY_WINDOW queries; safe to use from several threads
+class LatencyStats
+{
+public:
+    LatencyStats() : queries_(0), hits_(0) {}
+
+    void Record(double seconds, bool hit)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (window_.size() < QUERY_LATENCY_WINDOW)
+            window_.push_back(seconds);
+        else
+            window_[queries_ % QUERY_LATENCY_WINDOW] = seconds;
+        queries_++;
+        hits_ += hit;
+    }
+
+    // Appends "queries N hit rate H% p50 A us p99 B us" to text
+    void Append(std::string &text)
+    {
+        std::vector<double> window;
+        size_t queries, hits;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            window = window_;
+            queries = queries_;
+            hits = hits_;
+        }
+        char line[128];
+        std::snprintf(line, sizeof(line), "queries %zu hit rate %.1f%% p50 %.1f us p99 %.1f us", queries,
+                      queries ? 100.0 * hits / queries : 0.0, Percentile(window, 0.50) * 1e6,
+                      Percentile(window, 0.99) * 1e6);
+        text += line;
+    }
+
+private:
+    static double Percentile(std::vector<double> &window, double fraction)
+    {
+        if (window.empty())
+            return 0;
+        auto at = window.begin() + (size_t)(fraction * (window.size() - 1));
+        std::nth_element(window.begin(), at, window.end());
+        return *at;
+    }
+
+    std::mutex mutex_;
+    std::vector<double> window_; // a ring once full; queries_ % QUERY_LATENCY_WINDOW is the oldest entry
+    size_t queries_;
+    size_t hits_;
+};
+
+/*------------------------------------------------------------------------------
+ QueryServer
+  Answers point-to-point shortest path queries on a graph that stays loaded,
+  from a TreeCache of whole shortest path trees. A query whose source is not
+  cached builds that source's tree with the Dijkstra's algorithm, caches it and
+  answers from it, so later queries from the same source cost only the path.
+
+ Vairables:
+   - graph: the graph, a GraphType, a CsrGraph or a CsrGraphView; it must outlive the server
+   - cache_trees: the number of trees cached; 0 means as many as fit in QUERY_CACHE_BYTES, at most one per node
+
+ Requests are lines of text, and every request gets one line back:
+   - "source target": the path and its length, as a line of Lab3's output
+   - "stats": the LatencyStats line and the cache occupancy
+   - anything else: a line starting with "error"
+ Empty lines are skipped. Handle may be called from several threads at once.
+------------------------------------------------------------------------------*/
+template <typename Graph>
+class QueryServer
+{
+public:
+    QueryServer(const Graph &graph, size_t cache_trees = 0)
+        : graph_(graph),
+          cache_(cache_trees ? cache_trees
+                             : std::min<size_t>(NodeCount(graph),
+                                                QUERY_CACHE_BYTES / std::max<size_t>(1, (size_t)NodeCount(graph) *
+                                                                                            (sizeof(WeightType) + sizeof(NodeType)))))
+    {
+    }
+
+    // The path from source to target, as ExtractPath gives it; returns true if the tree of source was cached
+    bool Query(NodeType source, NodeType target, WeightType &path_len, std::vector<NodeType> &path)
+    {
+        TreeCache::TreePtr tree = cache_.Find(source);
+        const bool hit = tree != NULL;
+        if (!hit)
+        {
+            std::shared_ptr<ShortestPathTree> built(new ShortestPathTree);
+            BuildShortestPathTree(graph_, source, *built);
+            tree = cache_.Insert(built);
+        }
+        ExtractPath(*tree, target, path_len, path);
+        return hit;
+    }
+
+    // Appends the reply to the request line [begin, end) to reply
+    void Handle(const char *begin, const char *end, std::string &reply)
+    {
+        while (begin < end && std::isspace((unsigned char)end[-1]))
+            end--;
+        while (begin < end && std::isspace((unsigned char)*begin))
+            begin++;
+        if (begin == end)
+            return;
+        if (std::string(begin, end) == "stats")
+        {
+            AppendStats(reply);
+            return;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        unsigned long long source, target;
+        if (!ParseNode(begin, end, source) || !ParseNode(begin, end, target) || begin != end)
+        {
+            reply += "error: expected \"source target\" or \"stats\"\n";
+            return;
+        }
+        if (source >= NodeCount(graph_) || target >= NodeCount(graph_))
+        {
+            reply += "error: the graph has nodes 0 to " + std::to_string(NodeCount(graph_) - 1) + "\n";
+            return;
+        }
+        WeightType path_len;
+        std::vector<NodeType> &path = Path();
+        const bool hit = Query((NodeType)source, (NodeType)target, path_len, path);
+        AppendPathANDLength(path_len, path, reply);
+        stats_.Record(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), hit);
+    }
+
+    // Appends the stats line to text
+    void AppendStats(std::string &text)
+    {
+        stats_.Append(text);
+        text += " cached " + std::to_string(cache_.Size()) + "/" + std::to_string(cache_.Capacity()) + " trees\n";
+    }
+
+private:
+    // Reads an unsigned number after white space from [begin, end) and moves begin past it
+    static bool ParseNode(const char *&begin, const char *end, unsigned long long &value)
+    {
+        while (begin < end && (*begin == ' ' || *begin == '\t'))
+            begin++;
+        if (begin == end || (unsigned)(*begin - '0') >= 10)
+            return false;
+        value = 0;
+        while (begin < end && (unsigned)(*begin - '0') < 10 && value < UINT_MAX)
+            value = value * 10 + (unsigned)(*begin++ - '0');
+        return begin == end || *begin == ' ' || *begin == '\t';
+    }
+
+    // The path buffer of the calling thread
+    static std::vector<NodeType> &Path()
+    {
+        static thread_local std::vector<NodeType> path;
+        return path;
+    }
+
+    const Graph &graph_;
+    TreeCache cache_;
+    LatencyStats stats_;
+};
+
+// Writes all of text to fd; returns false if the other end is gone
+inline bool WriteAll(int fd, const std::string &text)
+{
+    for (size_t done = 0; done < text.size();)
+    {
+        ssize_t written = write(fd, text.data() + done, text.size() - done);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        done += (size_t)written;
+    }
+    return true;
+}
+
+// Answers the complete lines at the start of pending into reply and drops them from pending. Returns false, with
+// an error line in reply, if the unfinished line left over is longer than QUERY_MAX_LINE.
+template <typename Graph>
+bool AnswerLines(QueryServer<Graph> &server, std::string &pending, std::string &reply)
+{
+    size_t begin = 0;
+    for (size_t newline; (newline = pending.find('\n', begin)) != std::string::npos; begin = newline + 1)
+        server.Handle(pending.data() + begin, pending.data() + newline, reply);
+    pending.erase(0, begin);
+    if (pending.size() <= QUERY_MAX_LINE)
+        return true;
+    reply += "error: request line longer than " + std::to_string(QUERY_MAX_LINE) + " bytes\n";
+    return false;
+}
+
+/*------------------------------------------------------------------------------
+ ServeQueries
+  Answer the request lines read from in_fd on out_fd until in_fd ends. The
+  replies to all the complete lines of one read are written together, so a
+  client that sends many requests at once gets them back in few writes, and one
+  that waits for every reply still gets it right away. A line longer than
+  QUERY_MAX_LINE gets an error reply and ends the session, so a client that
+  never sends a newline cannot make the server buffer without limit.
+
+ Vairables:
+   - server: the QueryServer
+   - in_fd, out_fd: e.g. 0 and 1 for stdin and stdout
+
+------------------------------------------------------------------------------*/
+template <typename Graph>
+void ServeQueries(QueryServer<Graph> &server, int in_fd, int out_fd)
+{
+    std::vector<char> buffer(QUERY_READ_SIZE);
+    std::string pending, reply;
+    while (true)
+    {
+        ssize_t count = read(in_fd, buffer.data(), buffer.size());
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+        pending.append(buffer.data(), (size_t)count);
+        const bool ok = AnswerLines(server, pending, reply);
+        if (!WriteAll(out_fd, reply) || !ok)
+            return;
+        reply.clear();
+    }
+    // a last request without a newline
+    server.Handle(pending.data(), pending.data() + pending.size(), reply);
+    WriteAll(out_fd, reply);
+}
+
+/*------------------------------------------------------------------------------
+ ServeUnixSocket
+  Listen on a local Unix socket and answer the requests of its clients, until
+  the process is stopped. A socket left at the socket path, e.g. by an earlier
+  server, is replaced; any other file there is left alone and the server does
+  not start.
+
+ Vairables:
+   - server: the QueryServer, shared by all clients
+   - socket_path: the path of the socket
+   - num_threads: worker threads answering requests; 0 means one per hardware thread
+
+ The calling thread polls the listening socket and all idle clients. A client
+ with data to read is handed to a worker, which reads once, answers its complete
+ lines like ServeQueries and hands the client back to the poll. So a thread is
+ only taken while requests are answered, and any number of connected but idle
+ clients cannot hold up the others. A client that leaves its replies unread
+ for QUERY_SEND_TIMEOUT seconds is dropped.
+
+ Returns false if the socket cannot be set up.
+------------------------------------------------------------------------------*/
+template <typename Graph>
+bool ServeUnixSocket(QueryServer<Graph> &server, const char *socket_path, unsigned num_threads = 0)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (std::strlen(socket_path) >= sizeof(address.sun_path))
+        return false;
+    std::strcpy(address.sun_path, socket_path);
+    struct stat info;
+    if (lstat(socket_path, &info) == 0 && (!S_ISSOCK(info.st_mode) || unlink(socket_path) != 0))
+        return false;
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return false;
+    // wake[1] tells the poll that a worker handed a client back
+    int wake[2];
+    if (bind(listener, (const sockaddr *)&address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0 ||
+        pipe(wake) != 0)
+    {
+        close(listener);
+        return false;
+    }
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake[1], F_SETFL, O_NONBLOCK);
+    // a client that leaves before its replies are written must not stop the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::unordered_map<int, std::string> pending; // the unfinished request line of every client
+    std::set<int> idle;                            // the clients the poll waits on
+    std::deque<int> ready;                         // the clients with data, waiting for a worker
+    bool stop = false;
+
+    auto worker = [&]()
+    {
+        std::vector<char> buffer(QUERY_READ_SIZE);
+        std::string reply;
+        while (true)
+        {
+            int client;
+            std::string *text;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&]
+                               { return stop || !ready.empty(); });
+                if (stop)
+                    return;
+                client = ready.front();
+                ready.pop_front();
+                text = &pending[client];
+            }
+            ssize_t count = read(client, buffer.data(), buffer.size());
+            bool open = count > 0 || (count < 0 && (errno == EINTR || errno == EAGAIN));
+            if (count > 0)
+            {
+                text->append(buffer.data(), (size_t)count);
+                open = AnswerLines(server, *text, reply);
+            }
+            else if (count == 0) // a last request without a newline
+                server.Handle(text->data(), text->data() + text->size(), reply);
+            open = WriteAll(client, reply) && open;
+            reply.clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (open)
+                    idle.insert(client);
+                else
+                {
+                    pending.erase(client);
+                    close(client);
+                }
+            }
+            // a full pipe has wake-ups pending already
+            const char byte = 0;
+            while (write(wake[1], &byte, 1) < 0 && errno == EINTR)
+            {
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < num_threads; t++)
+        threads.push_back(std::thread(worker));
+
+    std::vector<pollfd> fds;
+    char drain[256];
+    while (true)
+    {
+        fds.clear();
+        fds.push_back(pollfd{listener, POLLIN, 0});
+        fds.push_back(pollfd{wake[0], POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int client : idle)
+                fds.push_back(pollfd{client, POLLIN, 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        while (read(wake[0], drain, sizeof(drain)) > 0)
+        {
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t k = 2; k < fds.size(); k++)
+            if (fds[k].revents)
+            {
+                idle.erase(fds[k].fd);
+                ready.push_back(fds[k].fd);
+                condition.notify_one();
+            }
+        if (fds[0].revents)
+            for (int client; (client = accept(listener, NULL, NULL)) >= 0;)
+            {
+                const timeval timeout = {QUERY_SEND_TIMEOUT, 0};
+                setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                pending[client].clear();
+                idle.insert(client);
+            }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    condition.notify_all();
+    for (auto &thread : threads)
+        thread.join();
+    for (auto &client : pending)
+        close(client.first);
+    close(wake[0]);
+    close(wake[1]);
+    close(listener);
+    return true;
+}
+
+#endif